@@ -25,5 +25,25 @@ public class QuickJSExecutor extends JavaScriptExecutor {
     return "QuickJSExecutor";
   }
 
+  /**
+   * Hold code cache writes back while {@code deferred} is true, e.g. from before the bundle is
+   * loaded until the first frame is rendered. Writes always happen off the JS thread.
+   */
+  public static native void setCodeCacheWriteDeferred(boolean deferred);
+
+  /**
+   * Bound the code caches kept on disk to {@code bytes}, least recently used bundles are evicted
+   * first. Defaults to 32MB.
+   */
+  public static native void setCodeCacheSizeBudget(long bytes);
+
+  /**
+   * Compress the code caches written from now on. Loading then reads less from storage but has to
+   * decompress, which pays off on slow storage: enable it for low-end device classes (e.g. when
+   * {@code ActivityManager.isLowRamDevice()}), leave it off on devices with fast storage. Caches
+   * stay readable either way.
+   */
+  public static native void setCodeCacheCompressed(boolean compressed);
+
   private static native HybridData initHybrid(final String codeCacheDir);
 }
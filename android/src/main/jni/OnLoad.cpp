@@ -1,4 +1,5 @@
 #include "QuickJSExecutorFactory.h"
+#include "QuickJSRuntimeFactory.h"
 #include <fbjni/fbjni.h>
 #include <folly/Memory.h>
 #include <glog/logging.h>
@@ -36,9 +37,30 @@ class QuickJSExecutorHolder
         codeCacheDir));
   }
 
+  static void setCodeCacheWriteDeferred(jni::alias_ref<jclass>, jboolean deferred) {
+    qjs::setCodeCacheWriteDeferred(deferred);
+  }
+
+  static void setCodeCacheSizeBudget(jni::alias_ref<jclass>, jlong bytes) {
+    qjs::setCodeCacheSizeBudget(static_cast<size_t>(bytes));
+  }
+
+  static void setCodeCacheCompressed(jni::alias_ref<jclass>, jboolean compressed) {
+    qjs::setCodeCacheCompressed(compressed);
+  }
+
   static void registerNatives() {
     registerHybrid({
         makeNativeMethod("initHybrid", QuickJSExecutorHolder::initHybrid),
+        makeNativeMethod(
+            "setCodeCacheWriteDeferred",
+            QuickJSExecutorHolder::setCodeCacheWriteDeferred),
+        makeNativeMethod(
+            "setCodeCacheSizeBudget",
+            QuickJSExecutorHolder::setCodeCacheSizeBudget),
+        makeNativeMethod(
+            "setCodeCacheCompressed",
+            QuickJSExecutorHolder::setCodeCacheCompressed),
     });
   }
 
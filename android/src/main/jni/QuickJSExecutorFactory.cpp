@@ -12,9 +12,15 @@ namespace qjs {
 namespace {
 
 std::unique_ptr<jsi::Runtime> makeQuickJSRuntimeSystraced(std::shared_ptr<react::ExecutorDelegate>
-        delegate, const std::string &codeCacheDir) {
+        delegate, const std::string &codeCacheDir,
+        std::shared_ptr<react::MessageQueueThread> jsQueue) {
   react::SystraceSection s("QuickJSExecutorFactory::makeQuickJSRuntimeSystraced");
-  return createQuickJSRuntime(codeCacheDir);
+  std::weak_ptr<react::MessageQueueThread> weakJSQueue = jsQueue;
+  return createQuickJSRuntime(codeCacheDir, [weakJSQueue](std::function<void()> &&task) {
+    if (auto queue = weakJSQueue.lock()) {
+      queue->runOnQueue(std::move(task));
+    }
+  });
 }
 
 } // namespace
@@ -22,7 +28,7 @@ std::unique_ptr<jsi::Runtime> makeQuickJSRuntimeSystraced(std::shared_ptr<react:
 std::unique_ptr<react::JSExecutor> QuickJSExecutorFactory::createJSExecutor(
     std::shared_ptr<react::ExecutorDelegate> delegate,
     std::shared_ptr<react::MessageQueueThread> jsQueue) {
-  std::unique_ptr<jsi::Runtime> quickJSRuntime = makeQuickJSRuntimeSystraced(delegate, codeCacheDir_);
+  std::unique_ptr<jsi::Runtime> quickJSRuntime = makeQuickJSRuntimeSystraced(delegate, codeCacheDir_, jsQueue);
 
   // Add js engine information to Error.prototype so in error reporting we
   // can send this information.
@@ -34,17 +40,8 @@ std::unique_ptr<react::JSExecutor> QuickJSExecutorFactory::createJSExecutor(
   return std::make_unique<QuickJSExecutor>(
       std::move(quickJSRuntime),
       delegate,
-      jsQueue,
       timeoutInvoker_,
       runtimeInstaller_);
 }
 
-QuickJSExecutor::QuickJSExecutor(
-    std::shared_ptr<jsi::Runtime> runtime,
-    std::shared_ptr<react::ExecutorDelegate> delegate,
-    std::shared_ptr<react::MessageQueueThread> jsQueue,
-    const react::JSIScopedTimeoutInvoker &timeoutInvoker,
-    RuntimeInstaller runtimeInstaller)
-    : JSIExecutor(runtime, delegate, timeoutInvoker, runtimeInstaller) {}
-
 } // namespace qjs
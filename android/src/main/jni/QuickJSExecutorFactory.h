@@ -2,6 +2,8 @@
 
 #include <jsireact/JSIExecutor.h>
 
+#include "QuickJSExecutor.h"
+
 namespace jsi = facebook::jsi;
 namespace react = facebook::react;
 
@@ -27,17 +29,4 @@ class QuickJSExecutorFactory : public react::JSExecutorFactory {
   std::string codeCacheDir_;
 };
 
-class QuickJSExecutor : public react::JSIExecutor {
- public:
-  QuickJSExecutor(
-      std::shared_ptr<jsi::Runtime> runtime,
-      std::shared_ptr<react::ExecutorDelegate> delegate,
-      std::shared_ptr<react::MessageQueueThread> jsQueue,
-      const react::JSIScopedTimeoutInvoker &timeoutInvoker,
-      RuntimeInstaller runtimeInstaller);
-
- private:
-  react::JSIScopedTimeoutInvoker timeoutInvoker_;
-};
-
 } // namespace qjs
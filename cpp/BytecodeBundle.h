@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace qjs {
+
+// A bytecode bundle is a JS bundle compiled ahead of time by
+// tools/precompiler: the magic below followed by the output of
+// JS_WriteObject. 0xC5 followed by an ASCII byte is invalid UTF-8, so the
+// magic can never be mistaken for the start of a source bundle.
+constexpr uint8_t kBytecodeBundleMagic[] = {0xC5, 'Q', 'J', 'B'};
+constexpr size_t kBytecodeBundleHeaderSize = sizeof(kBytecodeBundleMagic);
+
+inline bool isBytecodeBundle(const uint8_t *data, size_t size) {
+  return size > kBytecodeBundleHeaderSize &&
+      memcmp(data, kBytecodeBundleMagic, kBytecodeBundleHeaderSize) == 0;
+}
+
+} // namespace qjs
@@ -0,0 +1,215 @@
+#include "CodeCacheCompression.h"
+
+#include <string.h>
+
+namespace qjs {
+
+static constexpr uint32_t kRawBlock = 0x80000000;
+static constexpr size_t kMinMatch = 4;
+// The LZ4 format ends every block with literals: the last match starts at
+// least 12 bytes before the end and stops 5 bytes before it.
+static constexpr size_t kMatchStartMargin = 12;
+static constexpr size_t kLastLiterals = 5;
+static constexpr size_t kMaxOffset = 65535;
+static constexpr int kHashLog = 12;
+
+static inline uint32_t read32(const uint8_t *p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static inline uint32_t hash(uint32_t sequence) {
+  return (sequence * 2654435761U) >> (32 - kHashLog);
+}
+
+static inline uint8_t *writeLength(uint8_t *op, size_t length) {
+  while (length >= 255) {
+    *op++ = 255;
+    length -= 255;
+  }
+  *op++ = static_cast<uint8_t>(length);
+  return op;
+}
+
+static inline uint8_t *writeLiterals(uint8_t *op, const uint8_t *literals, size_t length) {
+  uint8_t *token = op++;
+  if (length >= 15) {
+    *token = 15 << 4;
+    op = writeLength(op, length - 15);
+  } else {
+    *token = static_cast<uint8_t>(length << 4);
+  }
+  memcpy(op, literals, length);
+  return op + length;
+}
+
+// Greedy single-pass LZ4 compression of one block. |out| has room for the
+// worst case, returns the compressed size.
+static size_t compressBlock(const uint8_t *src, size_t size, uint8_t *out) {
+  const uint8_t *ip = src;
+  const uint8_t *anchor = src;
+  const uint8_t *end = src + size;
+  uint8_t *op = out;
+
+  if (size > kMatchStartMargin) {
+    const uint8_t *matchStartLimit = end - kMatchStartMargin;
+    const uint8_t *matchLimit = end - kLastLiterals;
+    uint32_t table[1 << kHashLog] = {0};
+
+    while (ip < matchStartLimit) {
+      uint32_t sequence = read32(ip);
+      uint32_t h = hash(sequence);
+      const uint8_t *ref = src + table[h];
+      table[h] = static_cast<uint32_t>(ip - src);
+      if (ref >= ip || static_cast<size_t>(ip - ref) > kMaxOffset || read32(ref) != sequence) {
+        // Skip faster through data that does not compress.
+        ip += 1 + ((ip - anchor) >> 6);
+        continue;
+      }
+
+      while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+        ip--;
+        ref--;
+      }
+      const uint8_t *matchEnd = ip + kMinMatch;
+      const uint8_t *refEnd = ref + kMinMatch;
+      while (matchEnd < matchLimit && *matchEnd == *refEnd) {
+        matchEnd++;
+        refEnd++;
+      }
+
+      uint8_t *token = op;
+      op = writeLiterals(op, anchor, ip - anchor);
+      size_t offset = ip - ref;
+      *op++ = static_cast<uint8_t>(offset);
+      *op++ = static_cast<uint8_t>(offset >> 8);
+      size_t matchLength = matchEnd - ip - kMinMatch;
+      if (matchLength >= 15) {
+        *token |= 15;
+        op = writeLength(op, matchLength - 15);
+      } else {
+        *token |= static_cast<uint8_t>(matchLength);
+      }
+      ip = matchEnd;
+      anchor = ip;
+    }
+  }
+
+  op = writeLiterals(op, anchor, end - anchor);
+  return op - out;
+}
+
+static bool decompressBlock(const uint8_t *ip, size_t size, uint8_t *out, size_t rawSize) {
+  const uint8_t *end = ip + size;
+  uint8_t *op = out;
+  uint8_t *outEnd = out + rawSize;
+
+  while (ip < end) {
+    uint8_t token = *ip++;
+    size_t length = token >> 4;
+    if (length == 15) {
+      uint8_t byte;
+      do {
+        if (ip >= end) {
+          return false;
+        }
+        byte = *ip++;
+        length += byte;
+      } while (byte == 255);
+    }
+    if (length > static_cast<size_t>(end - ip) || length > static_cast<size_t>(outEnd - op)) {
+      return false;
+    }
+    memcpy(op, ip, length);
+    ip += length;
+    op += length;
+    if (ip == end) {
+      break;
+    }
+
+    if (end - ip < 2) {
+      return false;
+    }
+    size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > static_cast<size_t>(op - out)) {
+      return false;
+    }
+    length = token & 15;
+    if (length == 15) {
+      uint8_t byte;
+      do {
+        if (ip >= end) {
+          return false;
+        }
+        byte = *ip++;
+        length += byte;
+      } while (byte == 255);
+    }
+    length += kMinMatch;
+    if (length > static_cast<size_t>(outEnd - op)) {
+      return false;
+    }
+    const uint8_t *match = op - offset;
+    if (offset >= length) {
+      memcpy(op, match, length);
+      op += length;
+    } else {
+      // Overlapping match, repeats the last |offset| bytes.
+      while (length--) {
+        *op++ = *match++;
+      }
+    }
+  }
+  return op == outEnd;
+}
+
+void compressBlocks(const uint8_t *data, size_t size, std::vector<uint8_t> &out) {
+  for (size_t pos = 0; pos < size; pos += kCompressionBlockSize) {
+    size_t blockSize = size - pos < kCompressionBlockSize ? size - pos : kCompressionBlockSize;
+    size_t headerPos = out.size();
+    // Worst case of the LZ4 format: one length byte per 255 literals.
+    out.resize(headerPos + sizeof(uint32_t) + blockSize + blockSize / 255 + 16);
+    uint8_t *block = out.data() + headerPos + sizeof(uint32_t);
+    uint32_t compressedSize = static_cast<uint32_t>(compressBlock(data + pos, blockSize, block));
+    if (compressedSize >= blockSize) {
+      memcpy(block, data + pos, blockSize);
+      compressedSize = static_cast<uint32_t>(blockSize) | kRawBlock;
+    }
+    memcpy(out.data() + headerPos, &compressedSize, sizeof(compressedSize));
+    out.resize(headerPos + sizeof(uint32_t) + (compressedSize & ~kRawBlock));
+  }
+}
+
+bool decompressBlocks(const uint8_t *data, size_t size, uint8_t *out, size_t rawSize) {
+  const uint8_t *end = data + size;
+  size_t pos = 0;
+  while (data < end) {
+    uint32_t header;
+    if (static_cast<size_t>(end - data) < sizeof(header) || pos >= rawSize) {
+      return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    data += sizeof(header);
+    size_t blockSize = header & ~kRawBlock;
+    size_t rawBlockSize =
+        rawSize - pos < kCompressionBlockSize ? rawSize - pos : kCompressionBlockSize;
+    if (blockSize > static_cast<size_t>(end - data)) {
+      return false;
+    }
+    if (header & kRawBlock) {
+      if (blockSize != rawBlockSize) {
+        return false;
+      }
+      memcpy(out + pos, data, blockSize);
+    } else if (!decompressBlock(data, blockSize, out + pos, rawBlockSize)) {
+      return false;
+    }
+    data += blockSize;
+    pos += rawBlockSize;
+  }
+  return pos == rawSize;
+}
+
+} // namespace qjs
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace qjs {
+
+// Code cache payloads are compressed in independent blocks of
+// kCompressionBlockSize bytes, each encoded in the LZ4 block format:
+//
+//   u32 size | data
+//
+// The high bit of |size| is set when the block did not compress and is
+// stored as is. LZ4 decodes at several GB/s, so reading less from slow
+// storage easily pays for the decompression.
+constexpr size_t kCompressionBlockSize = 64 * 1024;
+
+// Appends |size| bytes of |data| compressed to |out|.
+void compressBlocks(const uint8_t *data, size_t size, std::vector<uint8_t> &out);
+
+// Decompresses the |size| bytes of blocks at |data| into exactly |rawSize|
+// bytes at |out|, one block after the other. Returns false if the blocks
+// are corrupted.
+bool decompressBlocks(const uint8_t *data, size_t size, uint8_t *out, size_t rawSize);
+
+} // namespace qjs
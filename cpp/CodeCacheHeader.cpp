@@ -0,0 +1,69 @@
+#include "CodeCacheHeader.h"
+
+#include "city.h"
+#include "quickjs.h"
+
+namespace qjs {
+
+static constexpr uint32_t kCodeCacheMagic = 0x43434a51; // "QJCC"
+static constexpr uint32_t kCodeCacheFormatVersion = 2;
+
+static constexpr size_t kFingerprintEdgeSize = 4096;
+static constexpr size_t kFingerprintSampleCount = 64;
+static constexpr size_t kFingerprintSampleSize = 64;
+
+// static
+CodeCacheHeader CodeCacheHeader::create(
+    uint32_t flags,
+    size_t payloadLength,
+    size_t startupLength,
+    size_t sourceLength,
+    uint64_t sourceFingerprint) {
+  CodeCacheHeader header;
+  header.magic = kCodeCacheMagic;
+  header.formatVersion = kCodeCacheFormatVersion;
+  header.bytecodeVersion = JS_GetBytecodeVersion();
+  header.flags = flags;
+  header.payloadLength = static_cast<uint32_t>(payloadLength);
+  header.payloadChecksum = 0;
+  header.startupLength = static_cast<uint32_t>(startupLength);
+  header.rawPayloadLength = 0;
+  header.sourceLength = sourceLength;
+  header.sourceFingerprint = sourceFingerprint;
+  return header;
+}
+
+bool CodeCacheHeader::isValid(uint32_t flags, size_t fileSize, size_t sourceLength) const {
+  return magic == kCodeCacheMagic &&
+      formatVersion == kCodeCacheFormatVersion &&
+      bytecodeVersion == JS_GetBytecodeVersion() &&
+      (this->flags & ~kCompressed) == flags &&
+      payloadLength > 0 &&
+      startupLength <= ((this->flags & kCompressed) ? rawPayloadLength : payloadLength) &&
+      fileSize == sizeof(CodeCacheHeader) + payloadLength &&
+      this->sourceLength == sourceLength;
+}
+
+uint64_t computeSourceFingerprint(const uint8_t *source, size_t size, uint32_t flags) {
+  const char *data = reinterpret_cast<const char *>(source);
+  if ((flags & CodeCacheHeader::kFullFingerprint) ||
+      size <= 2 * kFingerprintEdgeSize + kFingerprintSampleCount * kFingerprintSampleSize) {
+    return base::cityhash::CityHash64(data, size);
+  }
+
+  uint64_t hash = base::cityhash::CityHash64(data, kFingerprintEdgeSize);
+  hash = base::cityhash::CityHash64WithSeed(
+      data + size - kFingerprintEdgeSize, kFingerprintEdgeSize, hash);
+  size_t stride = (size - 2 * kFingerprintEdgeSize) / kFingerprintSampleCount;
+  for (size_t i = 0; i < kFingerprintSampleCount; i++) {
+    hash = base::cityhash::CityHash64WithSeed(
+        data + kFingerprintEdgeSize + i * stride, kFingerprintSampleSize, hash);
+  }
+  return hash;
+}
+
+uint32_t computePayloadChecksum(const uint8_t *payload, size_t size) {
+  return base::cityhash::CityHash32(reinterpret_cast<const char *>(payload), size);
+}
+
+} // namespace qjs
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace qjs {
+
+// Every code cache file starts with this header, followed by the payload
+// written by JS_WriteObject. Validating it only reads the header, never the
+// payload, so a stale cache is rejected before any bytecode is read.
+struct CodeCacheHeader {
+  // The fingerprint hashes the whole source instead of samples of it.
+  static constexpr uint32_t kFullFingerprint = 1 << 0;
+  // The payload is compressed by compressBlocks(). Set by the cache writer,
+  // a cache is readable whether it is compressed or not.
+  static constexpr uint32_t kCompressed = 1 << 1;
+
+  uint32_t magic;
+  uint32_t formatVersion;
+  // JS_GetBytecodeVersion() of the engine that wrote the payload.
+  uint32_t bytecodeVersion;
+  uint32_t flags;
+  uint32_t payloadLength;
+  // Filled in by the cache writer, off the JS thread.
+  uint32_t payloadChecksum;
+  // Length of the payload prefix holding the atoms and the functions run
+  // at startup, 0 if the payload is not laid out in startup order.
+  uint32_t startupLength;
+  // Length of the payload once decompressed, only set with kCompressed.
+  uint32_t rawPayloadLength;
+  uint64_t sourceLength;
+  uint64_t sourceFingerprint;
+
+  static CodeCacheHeader create(
+      uint32_t flags,
+      size_t payloadLength,
+      size_t startupLength,
+      size_t sourceLength,
+      uint64_t sourceFingerprint);
+
+  // Checks everything but the fingerprint and the payload checksum.
+  bool isValid(uint32_t flags, size_t fileSize, size_t sourceLength) const;
+};
+
+static_assert(sizeof(CodeCacheHeader) == 48, "CodeCacheHeader must not be padded");
+
+// With kFullFingerprint the whole source is hashed. Otherwise only its head,
+// tail and evenly spread samples are, which is O(1) in the bundle size.
+uint64_t computeSourceFingerprint(const uint8_t *source, size_t size, uint32_t flags);
+
+uint32_t computePayloadChecksum(const uint8_t *payload, size_t size);
+
+} // namespace qjs
@@ -0,0 +1,467 @@
+#include "CodeCacheStore.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include <glog/logging.h>
+
+#include "CodeCacheCompression.h"
+#include "CodeCacheHeader.h"
+#include "CodeCacheWriter.h"
+
+namespace qjs {
+
+static constexpr uint32_t kDataMagic = 0x53434a51; // "QJCS"
+static constexpr uint32_t kIndexMagic = 0x49434a51; // "QJCI"
+static constexpr uint32_t kStoreVersion = 2;
+
+// magic, version, generation
+static constexpr size_t kDataHeaderSize = 16;
+// Entries start 16 bytes aligned, so that their header can be read in place.
+static constexpr uint64_t kEntryAlignment = 16;
+// Don't bother compacting less garbage than this.
+static constexpr uint64_t kMinCompactionSize = 1024 * 1024;
+
+std::atomic<size_t> CodeCacheStore::sizeBudget_(32 * 1024 * 1024);
+std::atomic<bool> CodeCacheStore::compression_(false);
+
+namespace {
+
+class IndexWriter {
+ public:
+  template <typename T>
+  void put(T value) {
+    auto bytes = reinterpret_cast<const uint8_t *>(&value);
+    data_.insert(data_.end(), bytes, bytes + sizeof(T));
+  }
+
+  void put(const std::string &value) {
+    put(static_cast<uint32_t>(value.size()));
+    data_.insert(data_.end(), value.begin(), value.end());
+  }
+
+  std::vector<uint8_t> &data() {
+    return data_;
+  }
+
+ private:
+  std::vector<uint8_t> data_;
+};
+
+class IndexReader {
+ public:
+  IndexReader(const std::vector<uint8_t> &data) : data_(data) {};
+
+  template <typename T>
+  bool get(T &value) {
+    if (data_.size() - pos_ < sizeof(T)) {
+      return false;
+    }
+    memcpy(&value, data_.data() + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return true;
+  }
+
+  bool get(std::string &value) {
+    uint32_t size;
+    if (!get(size) || data_.size() - pos_ < size) {
+      return false;
+    }
+    value.assign(reinterpret_cast<const char *>(data_.data()) + pos_, size);
+    pos_ += size;
+    return true;
+  }
+
+ private:
+  const std::vector<uint8_t> &data_;
+  size_t pos_ = 0;
+};
+
+bool readFile(const std::string &path, std::vector<uint8_t> &data) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  bool ok = fstat(fd, &st) == 0;
+  if (ok) {
+    data.resize(st.st_size);
+    ok = pread(fd, data.data(), data.size(), 0) == static_cast<ssize_t>(data.size());
+  }
+  close(fd);
+  return ok;
+}
+
+bool readAt(int fd, uint8_t *data, size_t size, uint64_t offset) {
+  while (size > 0) {
+    ssize_t n = pread(fd, data, size, offset);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+bool writeAt(int fd, const uint8_t *data, size_t size, uint64_t offset) {
+  return lseek(fd, offset, SEEK_SET) == static_cast<off_t>(offset) &&
+      CodeCacheWriter::writeFully(fd, data, size);
+}
+
+bool writeDataHeader(int fd, uint64_t generation) {
+  uint8_t header[kDataHeaderSize];
+  memcpy(header, &kDataMagic, 4);
+  memcpy(header + 4, &kStoreVersion, 4);
+  memcpy(header + 8, &generation, 8);
+  return writeAt(fd, header, sizeof(header), 0);
+}
+
+uint64_t newGeneration() {
+  return std::chrono::system_clock::now().time_since_epoch().count();
+}
+
+uint64_t alignEntry(uint64_t offset) {
+  return (offset + kEntryAlignment - 1) & ~(kEntryAlignment - 1);
+}
+
+void adviseWillNeed(int fd, uint64_t offset, uint64_t size) {
+#if defined(__APPLE__)
+  struct radvisory advisory;
+  advisory.ra_offset = static_cast<off_t>(offset);
+  advisory.ra_count = static_cast<int>(size);
+  fcntl(fd, F_RDADVISE, &advisory);
+#else
+  posix_fadvise(fd, offset, size, POSIX_FADV_WILLNEED);
+#endif
+}
+
+} // namespace
+
+// static
+CodeCacheStore &CodeCacheStore::get(const std::string &dir) {
+  // Intentionally leaked, the writer thread may still use them at exit.
+  static std::mutex *mutex = new std::mutex();
+  static auto *stores = new std::unordered_map<std::string, CodeCacheStore *>();
+
+  std::lock_guard<std::mutex> lock(*mutex);
+  auto &store = (*stores)[dir];
+  if (store == nullptr) {
+    store = new CodeCacheStore(dir);
+  }
+  return *store;
+}
+
+// static
+void CodeCacheStore::setSizeBudget(size_t bytes) {
+  sizeBudget_ = bytes;
+}
+
+// static
+void CodeCacheStore::setCompression(bool compression) {
+  compression_ = compression;
+}
+
+CodeCacheStore::CodeCacheStore(const std::string &dir)
+    : dataPath_(dir + "/codecache.data"), indexPath_(dir + "/codecache.index") {
+  load();
+  prefetch();
+}
+
+void CodeCacheStore::load() {
+  fd_ = open(dataPath_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    LOG(ERROR) << "open codecache store failed " << dataPath_;
+    return;
+  }
+
+  struct stat st;
+  uint8_t header[kDataHeaderSize];
+  uint32_t magic = 0, version = 0;
+  if (fstat(fd_, &st) == 0 && readAt(fd_, header, sizeof(header), 0)) {
+    memcpy(&magic, header, 4);
+    memcpy(&version, header + 4, 4);
+    memcpy(&generation_, header + 8, 8);
+  }
+  if (magic != kDataMagic || version != kStoreVersion) {
+    needsReset_ = true;
+    return;
+  }
+  dataSize_ = st.st_size;
+
+  std::vector<uint8_t> data;
+  if (!readFile(indexPath_, data)) {
+    needsReset_ = true;
+    return;
+  }
+
+  IndexReader reader(data);
+  uint64_t generation;
+  uint32_t count;
+  if (!reader.get(magic) || magic != kIndexMagic ||
+      !reader.get(version) || version != kStoreVersion ||
+      !reader.get(generation) || generation != generation_ ||
+      !reader.get(launch_) || !reader.get(count)) {
+    // Entries of another generation of the data file, or a crash in the
+    // middle of a compaction.
+    needsReset_ = true;
+    return;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    std::string key;
+    Entry entry;
+    if (!reader.get(key) || !reader.get(entry.offset) ||
+        !reader.get(entry.size) || !reader.get(entry.prefetchSize) ||
+        !reader.get(entry.lastUsed) || entry.prefetchSize > entry.size ||
+        entry.offset < kDataHeaderSize || entry.offset + entry.size > dataSize_) {
+      index_.clear();
+      liveSize_ = 0;
+      needsReset_ = true;
+      return;
+    }
+    liveSize_ += entry.size;
+    index_[key] = entry;
+  }
+  launch_++;
+}
+
+void CodeCacheStore::prefetch() {
+  // The entries used by the previous launch are likely needed at startup,
+  // read them ahead in as few requests as possible. Entries laid out in
+  // startup order only have their startup prefix read ahead.
+  std::vector<std::pair<uint64_t, uint64_t>> ranges;
+  for (auto &item : index_) {
+    const Entry &entry = item.second;
+    if (entry.lastUsed + 1 == launch_) {
+      uint64_t size = entry.prefetchSize ? entry.prefetchSize : entry.size;
+      ranges.emplace_back(entry.offset, entry.offset + size);
+    }
+  }
+  std::sort(ranges.begin(), ranges.end());
+
+  size_t i = 0;
+  while (i < ranges.size()) {
+    uint64_t start = ranges[i].first;
+    uint64_t end = ranges[i].second;
+    for (i++; i < ranges.size() && ranges[i].first <= alignEntry(end); i++) {
+      end = std::max(end, ranges[i].second);
+    }
+    adviseWillNeed(fd_, start, end - start);
+  }
+}
+
+std::unique_ptr<MappedFile> CodeCacheStore::read(const std::string &key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end() || fd_ < 0) {
+    return nullptr;
+  }
+
+  auto mappedFile = MappedFile::map(fd_, it->second.offset, it->second.size);
+  if (mappedFile && it->second.lastUsed != launch_) {
+    it->second.lastUsed = launch_;
+    scheduleIndexWrite();
+  }
+  return mappedFile;
+}
+
+void CodeCacheStore::write(
+    const std::string &key, std::vector<uint8_t> &&data, size_t prefetchSize) {
+  CodeCacheWriter::getInstance().post(
+      dataPath_ + ":" + key,
+      [this, key, data = std::move(data), prefetchSize]() mutable {
+        append(key, data, prefetchSize);
+      });
+}
+
+void CodeCacheStore::append(
+    const std::string &key, std::vector<uint8_t> &data, size_t prefetchSize) {
+  if (compression_ && data.size() > sizeof(CodeCacheHeader) && compress(data)) {
+    // A compressed cache is decompressed whole when it is loaded, so it is
+    // prefetched whole too. The startup layout doesn't apply to it.
+    prefetchSize = 0;
+  }
+
+  // Checksumming is O(cache size), keep it off the JS thread as well.
+  if (data.size() > sizeof(CodeCacheHeader)) {
+    auto header = reinterpret_cast<CodeCacheHeader *>(data.data());
+    header->payloadChecksum = computePayloadChecksum(
+        data.data() + sizeof(CodeCacheHeader), data.size() - sizeof(CodeCacheHeader));
+  }
+
+  uint64_t offset;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd_ < 0 || (needsReset_ && !reset())) {
+      return;
+    }
+    offset = alignEntry(dataSize_);
+  }
+
+  // Only this thread writes the file, readers only see the entry once it
+  // is synced.
+  if (!writeAt(fd_, data.data(), data.size(), offset) || fsync(fd_) != 0) {
+    LOG(ERROR) << "write codecache failed " << key;
+    return;
+  }
+
+  bool needsCompaction;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      liveSize_ -= it->second.size;
+    }
+    index_[key] = {offset, data.size(), std::min<uint64_t>(prefetchSize, data.size()), launch_};
+    liveSize_ += data.size();
+    dataSize_ = offset + data.size();
+    evict(key);
+
+    uint64_t garbageSize = dataSize_ - kDataHeaderSize - liveSize_;
+    needsCompaction = garbageSize > liveSize_ && garbageSize > kMinCompactionSize;
+  }
+
+  if (needsCompaction && !compact()) {
+    LOG(ERROR) << "compact codecache failed " << dataPath_;
+  }
+  writeIndex();
+}
+
+bool CodeCacheStore::compress(std::vector<uint8_t> &data) {
+  const uint8_t *payload = data.data() + sizeof(CodeCacheHeader);
+  size_t payloadSize = data.size() - sizeof(CodeCacheHeader);
+  std::vector<uint8_t> compressed(data.begin(), data.begin() + sizeof(CodeCacheHeader));
+  compressBlocks(payload, payloadSize, compressed);
+  if (compressed.size() >= data.size()) {
+    return false;
+  }
+
+  auto header = reinterpret_cast<CodeCacheHeader *>(compressed.data());
+  header->flags |= CodeCacheHeader::kCompressed;
+  header->rawPayloadLength = static_cast<uint32_t>(payloadSize);
+  header->payloadLength = static_cast<uint32_t>(compressed.size() - sizeof(CodeCacheHeader));
+  data.swap(compressed);
+  return true;
+}
+
+bool CodeCacheStore::reset() {
+  index_.clear();
+  liveSize_ = 0;
+  generation_ = newGeneration();
+  if (ftruncate(fd_, 0) != 0 || !writeDataHeader(fd_, generation_)) {
+    return false;
+  }
+  dataSize_ = kDataHeaderSize;
+  needsReset_ = false;
+  return true;
+}
+
+void CodeCacheStore::evict(const std::string &keep) {
+  size_t budget = sizeBudget_;
+  while (liveSize_ > budget) {
+    auto lru = index_.end();
+    for (auto it = index_.begin(); it != index_.end(); ++it) {
+      if (it->first != keep &&
+          (lru == index_.end() || it->second.lastUsed < lru->second.lastUsed)) {
+        lru = it;
+      }
+    }
+    if (lru == index_.end()) {
+      break;
+    }
+    liveSize_ -= lru->second.size;
+    index_.erase(lru);
+  }
+}
+
+bool CodeCacheStore::compact() {
+  std::unordered_map<std::string, Entry> entries;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries = index_;
+  }
+
+  // Copy the live entries to a new data file. Runtimes keep their mappings
+  // of the old one, which lives on until they are unmapped.
+  std::string tmpPath = dataPath_ + ".tmp";
+  int fd = open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  uint64_t generation = newGeneration();
+  bool ok = writeDataHeader(fd, generation);
+  uint64_t offset = kDataHeaderSize;
+  std::vector<uint8_t> buffer;
+  for (auto it = entries.begin(); ok && it != entries.end(); ++it) {
+    buffer.resize(it->second.size);
+    offset = alignEntry(offset);
+    ok = readAt(fd_, buffer.data(), buffer.size(), it->second.offset) &&
+        writeAt(fd, buffer.data(), buffer.size(), offset);
+    it->second.offset = offset;
+    offset += buffer.size();
+  }
+  ok = ok && fsync(fd) == 0 && rename(tmpPath.c_str(), dataPath_.c_str()) == 0;
+  if (!ok) {
+    close(fd);
+    unlink(tmpPath.c_str());
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Entries are only added and evicted on this thread, the copy is still
+  // complete.
+  for (auto &item : index_) {
+    auto it = entries.find(item.first);
+    if (it != entries.end()) {
+      item.second.offset = it->second.offset;
+    }
+  }
+  close(fd_);
+  fd_ = fd;
+  generation_ = generation;
+  dataSize_ = offset;
+  return true;
+}
+
+void CodeCacheStore::writeIndex() {
+  IndexWriter writer;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (needsReset_) {
+      return;
+    }
+    writer.put(kIndexMagic);
+    writer.put(kStoreVersion);
+    writer.put(generation_);
+    writer.put(launch_);
+    writer.put(static_cast<uint32_t>(index_.size()));
+    for (auto &item : index_) {
+      writer.put(item.first);
+      writer.put(item.second.offset);
+      writer.put(item.second.size);
+      writer.put(item.second.prefetchSize);
+      writer.put(item.second.lastUsed);
+    }
+  }
+  if (!CodeCacheWriter::writeAtomically(indexPath_, writer.data())) {
+    LOG(ERROR) << "write codecache index failed " << indexPath_;
+  }
+}
+
+void CodeCacheStore::scheduleIndexWrite() {
+  CodeCacheWriter::getInstance().post(indexPath_, [this]() { writeIndex(); });
+}
+
+} // namespace qjs
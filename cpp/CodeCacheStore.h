@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.h"
+
+namespace qjs {
+
+// All the code caches of a directory, packed in one append-only data file
+// plus an index keyed by cache key.
+// - Reading an entry maps it from the data file, which is kept open, so
+//   there is no open/stat/read per bundle.
+// - The entries used by the previous launch are prefetched in one batch as
+//   soon as the store is opened.
+// - Once the entries exceed the size budget the least recently used ones
+//   are evicted, and the data file is compacted when it is mostly garbage.
+// Everything but reads runs on the CodeCacheWriter thread.
+class CodeCacheStore {
+ public:
+  // Stores are shared by all the runtimes using the same directory.
+  static CodeCacheStore &get(const std::string &dir);
+
+  // Applies to all the stores.
+  static void setSizeBudget(size_t bytes);
+
+  // Compress the entries written from now on, trading CPU at load time
+  // for less I/O.
+  static void setCompression(bool compression);
+
+  // Maps the entry for |key|, nullptr if there is none.
+  std::unique_ptr<MappedFile> read(const std::string &key);
+
+  // Queues |data| to become the entry for |key|. When it is used at
+  // startup only its first |prefetchSize| bytes are prefetched, 0 means all.
+  void write(const std::string &key, std::vector<uint8_t> &&data, size_t prefetchSize = 0);
+
+ private:
+  struct Entry {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t prefetchSize;
+    // Launch the entry was last used in.
+    uint64_t lastUsed;
+  };
+
+  explicit CodeCacheStore(const std::string &dir);
+
+  // Prevent copying of the store.
+  CodeCacheStore(const CodeCacheStore &) = delete;
+  CodeCacheStore &operator=(const CodeCacheStore &) = delete;
+
+  void load();
+  void prefetch();
+
+  // Writer thread only.
+  void append(const std::string &key, std::vector<uint8_t> &data, size_t prefetchSize);
+  // Replaces the payload of |data| by its compressed blocks, unless that
+  // doesn't make it smaller. Returns whether it did.
+  static bool compress(std::vector<uint8_t> &data);
+  bool reset();
+  bool compact();
+  void writeIndex();
+
+  // mutex_ must be held.
+  void evict(const std::string &keep);
+  void scheduleIndexWrite();
+
+  static std::atomic<size_t> sizeBudget_;
+  static std::atomic<bool> compression_;
+
+  std::string dataPath_;
+  std::string indexPath_;
+
+  std::mutex mutex_;
+  int fd_ = -1;
+  uint64_t generation_ = 0;
+  uint64_t launch_ = 0;
+  uint64_t dataSize_ = 0;
+  uint64_t liveSize_ = 0;
+  // The data file does not match the index, it is reset on the next write.
+  bool needsReset_ = false;
+  std::unordered_map<std::string, Entry> index_;
+};
+
+} // namespace qjs
@@ -0,0 +1,113 @@
+#include "CodeCacheWriter.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+namespace qjs {
+
+// static
+CodeCacheWriter &CodeCacheWriter::getInstance() {
+  // Intentionally leaked, the worker thread may still be running at exit.
+  static CodeCacheWriter *instance = new CodeCacheWriter();
+  return *instance;
+}
+
+void CodeCacheWriter::post(const std::string &id, std::function<void()> &&task) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &pending : queue_) {
+    if (pending.id == id) {
+      pending.run = std::move(task);
+      return;
+    }
+  }
+  queue_.push_back({id, std::move(task)});
+  ensureThread();
+  condition_.notify_one();
+}
+
+bool CodeCacheWriter::isDeferred() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return deferred_;
+}
+
+void CodeCacheWriter::setDeferred(bool deferred) {
+  std::vector<std::function<void()>> callbacks;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    deferred_ = deferred;
+    if (!deferred) {
+      callbacks.swap(undeferredCallbacks_);
+    }
+    condition_.notify_one();
+  }
+  for (auto &callback : callbacks) {
+    callback();
+  }
+}
+
+bool CodeCacheWriter::runWhenUndeferred(std::function<void()> callback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!deferred_) {
+    return false;
+  }
+  undeferredCallbacks_.push_back(std::move(callback));
+  return true;
+}
+
+void CodeCacheWriter::ensureThread() {
+  if (started_) {
+    return;
+  }
+  started_ = true;
+  std::thread(&CodeCacheWriter::run, this).detach();
+}
+
+void CodeCacheWriter::run() {
+  for (;;) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this] { return !deferred_ && !queue_.empty(); });
+      task = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    task.run();
+  }
+}
+
+// static
+bool CodeCacheWriter::writeFully(int fd, const uint8_t *data, size_t size) {
+  while (size > 0) {
+    ssize_t written = ::write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+// static
+bool CodeCacheWriter::writeAtomically(const std::string &path, const std::vector<uint8_t> &data) {
+  std::string tmpPath = path + ".tmp";
+  int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+
+  bool ok = writeFully(fd, data.data(), data.size()) && fsync(fd) == 0;
+  ok = (close(fd) == 0) && ok;
+  if (ok && rename(tmpPath.c_str(), path.c_str()) == 0) {
+    return true;
+  }
+  unlink(tmpPath.c_str());
+  return false;
+}
+
+} // namespace qjs
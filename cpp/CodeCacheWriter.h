@@ -0,0 +1,65 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace qjs {
+
+// Runs code cache I/O on a background thread so that serializing the cache
+// never blocks the JS thread. Files are written to a temporary path,
+// fsync'ed and renamed over the destination, so a crash mid-write can never
+// leave a truncated file behind.
+class CodeCacheWriter {
+ public:
+  static CodeCacheWriter &getInstance();
+
+  // Queue |task| to run on the writer thread. A later task with the same
+  // |id| replaces a pending one.
+  void post(const std::string &id, std::function<void()> &&task);
+
+  // While deferred, tasks are only queued. Clearing the flag (e.g. once the
+  // first frame is rendered) releases everything that is pending.
+  void setDeferred(bool deferred);
+
+  bool isDeferred();
+
+  // Runs |callback| once, on the thread that clears the deferred flag.
+  // Returns false without keeping |callback| if writes are not deferred.
+  bool runWhenUndeferred(std::function<void()> callback);
+
+  // Atomically replaces |path| with |data|.
+  static bool writeAtomically(const std::string &path, const std::vector<uint8_t> &data);
+
+  // Writes all of |data| at the current offset of |fd|.
+  static bool writeFully(int fd, const uint8_t *data, size_t size);
+
+ private:
+  struct Task {
+    std::string id;
+    std::function<void()> run;
+  };
+
+  CodeCacheWriter() = default;
+
+  // Prevent copying of the writer.
+  CodeCacheWriter(const CodeCacheWriter &) = delete;
+  CodeCacheWriter &operator=(const CodeCacheWriter &) = delete;
+
+  void ensureThread();
+  void run();
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<Task> queue_;
+  std::vector<std::function<void()>> undeferredCallbacks_;
+  bool deferred_ = false;
+  bool started_ = false;
+};
+
+} // namespace qjs
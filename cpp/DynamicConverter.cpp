@@ -0,0 +1,247 @@
+#include "DynamicConverter.h"
+
+#include "JSIValueConverter.h"
+#include "ScopedJSValue.h"
+
+namespace qjs {
+
+// jsi::dynamicFromValue does not detect cycles, this turns them into an
+// exception instead of exhausting the memory.
+static constexpr int kMaxDepth = 512;
+
+// static
+folly::dynamic DynamicConverter::ToDynamic(
+    const QuickJSRuntime &runtime,
+    const jsi::Value &value) {
+  // TRACE_SCOPE("DynamicConverter", "ToDynamic");
+  auto context = runtime.getJSContext();
+  JSValue jsValue = JSIValueConverter::ToJSValue(runtime, value);
+  ScopedJSValue scopedValue(context, &jsValue);
+  return ToDynamic(runtime, jsValue, 0);
+}
+
+// static
+folly::dynamic DynamicConverter::ToDynamic(
+    const QuickJSRuntime &runtime,
+    JSValueConst value,
+    int depth) {
+  auto context = runtime.getJSContext();
+  switch (JS_VALUE_GET_NORM_TAG(value)) {
+    case JS_TAG_UNDEFINED:
+    case JS_TAG_NULL:
+      return nullptr;
+    case JS_TAG_BOOL:
+      return static_cast<bool>(JS_VALUE_GET_BOOL(value));
+    // Numbers are always doubles, as with jsi::dynamicFromValue. The native
+    // modules read them with getDouble().
+    case JS_TAG_INT:
+      return static_cast<double>(JS_VALUE_GET_INT(value));
+    case JS_TAG_FLOAT64:
+      return JS_VALUE_GET_FLOAT64(value);
+    case JS_TAG_STRING: {
+      size_t length;
+      const char *str = JS_ToCStringLen(context, &length, value);
+      if (!str) {
+        runtime.checkAndThrowException(context);
+      }
+      ScopedCString scopedCString(context, str);
+      return std::string(str, length);
+    }
+    case JS_TAG_OBJECT:
+      if (depth >= kMaxDepth) {
+        throw jsi::JSError(const_cast<QuickJSRuntime &>(runtime),
+                           "Object is too deep or cyclic to convert to dynamic");
+      }
+      if (JS_IsFunction(context, value)) {
+        throw jsi::JSError(const_cast<QuickJSRuntime &>(runtime),
+                           "JS Functions are not convertible to dynamic");
+      }
+      return JS_IsArray(context, value) > 0
+          ? ArrayToDynamic(runtime, value, depth + 1)
+          : ObjectToDynamic(runtime, value, depth + 1);
+    case JS_TAG_SYMBOL:
+      throw jsi::JSError(const_cast<QuickJSRuntime &>(runtime),
+                         "JS Symbols are not convertible to dynamic");
+    default:
+      throw jsi::JSError(const_cast<QuickJSRuntime &>(runtime),
+                         "JS BigInts are not convertible to dynamic");
+  }
+}
+
+// static
+folly::dynamic DynamicConverter::ArrayToDynamic(
+    const QuickJSRuntime &runtime,
+    JSValueConst array,
+    int depth) {
+  auto context = runtime.getJSContext();
+  folly::dynamic result = folly::dynamic::array();
+
+  JSValue lengthValue = JS_GetPropertyStr(context, array, "length");
+  ScopedJSValue scopedLength(context, &lengthValue);
+  int64_t size;
+  if (JS_ToInt64(context, &size, lengthValue) < 0) {
+    runtime.checkAndThrowException(context);
+  }
+  JSValue *values;
+  uint32_t count;
+  if (JS_GetFastArray(context, array, &values, &count)) {
+    result.reserve(count);
+  }
+  for (int64_t i = 0; i < size; i++) {
+    // Converting an element may run a getter that resizes the array, so the
+    // elements are fetched again for every index. Fast arrays only store up
+    // to their last element, the holes after it are null like with
+    // jsi::dynamicFromValue.
+    JSValue element;
+    if (JS_GetFastArray(context, array, &values, &count)) {
+      element = i < count ? JS_DupValue(context, values[i]) : JS_UNDEFINED;
+    } else {
+      element = JS_GetPropertyUint32(context, array, static_cast<uint32_t>(i));
+    }
+    ScopedJSValue scopedElement(context, &element);
+    if (JS_IsException(element)) {
+      runtime.checkAndThrowException(context);
+    }
+    result.push_back(ToDynamic(runtime, element, depth));
+  }
+  return result;
+}
+
+// static
+folly::dynamic DynamicConverter::ObjectToDynamic(
+    const QuickJSRuntime &runtime,
+    JSValueConst object,
+    int depth) {
+  auto context = runtime.getJSContext();
+  folly::dynamic result = folly::dynamic::object();
+
+  // Same as jsi::dynamicFromValue: undefined properties are skipped and
+  // functions become null, like JSON.stringify does.
+  auto insert = [&](JSAtom atom, JSValueConst value) {
+    if (JS_IsUndefined(value)) {
+      return;
+    }
+    result.insert(
+        JSIValueConverter::ToSTLString(context, atom),
+        JS_IsFunction(context, value) ? folly::dynamic(nullptr)
+                                      : ToDynamic(runtime, value, depth));
+  };
+
+  int count = JS_GetShapePropertyCount(context, object);
+  if (count >= 0) {
+    for (int i = 0; i < count; i++) {
+      JSAtom atom;
+      JSValueConst value;
+      if (!JS_GetShapeProperty(context, object, i, &atom, &value)) {
+        continue;
+      }
+      // Held while converting in case the property is deleted meanwhile.
+      JSValue property = JS_DupValue(context, value);
+      ScopedJSValue scopedProperty(context, &property);
+      ScopedJSAtom scopedAtom(context, JS_DupAtom(context, atom));
+      insert(scopedAtom.get(), property);
+    }
+    return result;
+  }
+
+  JSPropertyEnum *names;
+  uint32_t size;
+  if (JS_GetOwnPropertyNames(context, &names, &size, object,
+                             JS_GPN_ENUM_ONLY | JS_GPN_STRING_MASK) < 0) {
+    runtime.checkAndThrowException(context);
+  }
+  try {
+    for (uint32_t i = 0; i < size; i++) {
+      JSValue property = JS_GetProperty(context, object, names[i].atom);
+      ScopedJSValue scopedProperty(context, &property);
+      if (JS_IsException(property)) {
+        runtime.checkAndThrowException(context);
+      }
+      insert(names[i].atom, property);
+    }
+  } catch (...) {
+    JS_FreeEnumArray(context, names, size);
+    throw;
+  }
+  JS_FreeEnumArray(context, names, size);
+  return result;
+}
+
+// static
+jsi::Value DynamicConverter::ToJSIValue(
+    const QuickJSRuntime &runtime,
+    const folly::dynamic &dynamic) {
+  // TRACE_SCOPE("DynamicConverter", "ToJSIValue");
+  auto context = runtime.getJSContext();
+  JSValue value = ToJSValue(context, dynamic);
+  if (JS_IsException(value)) {
+    runtime.checkAndThrowException(context);
+  }
+  ScopedJSValue scopedValue(context, &value);
+  return JSIValueConverter::ToJSIValue(runtime, value);
+}
+
+// static
+JSValue DynamicConverter::ToJSValue(JSContext *context, const folly::dynamic &dynamic) {
+  switch (dynamic.type()) {
+    case folly::dynamic::NULLT:
+      return JS_NULL;
+    case folly::dynamic::BOOL:
+      return JS_NewBool(context, dynamic.getBool());
+    case folly::dynamic::INT64:
+      return JSIValueConverter::ToJSNumber(context, static_cast<double>(dynamic.getInt()));
+    case folly::dynamic::DOUBLE:
+      return JSIValueConverter::ToJSNumber(context, dynamic.getDouble());
+    case folly::dynamic::STRING: {
+      const auto &string = dynamic.getString();
+      return JS_NewStringLen(context, string.data(), string.size());
+    }
+    case folly::dynamic::ARRAY: {
+      JSValue array = JS_NewArrayLength(context, static_cast<uint32_t>(dynamic.size()));
+      if (JS_IsException(array)) {
+        return array;
+      }
+      // Defining the elements in order keeps the array fast, its storage is
+      // already allocated.
+      uint32_t index = 0;
+      for (const auto &item : dynamic) {
+        JSValue element = ToJSValue(context, item);
+        if (JS_IsException(element) ||
+            JS_DefinePropertyValueUint32(context, array, index++, element, JS_PROP_C_W_E) < 0) {
+          JS_FreeValue(context, array);
+          return JS_EXCEPTION;
+        }
+      }
+      return array;
+    }
+    case folly::dynamic::OBJECT: {
+      JSValue object = JS_NewObject(context);
+      if (JS_IsException(object)) {
+        return object;
+      }
+      for (const auto &item : dynamic.items()) {
+        JSValue property = ToJSValue(context, item.second);
+        if (JS_IsException(property)) {
+          JS_FreeValue(context, object);
+          return JS_EXCEPTION;
+        }
+        const auto &key = item.first.isString() ? item.first.getString()
+                                                : item.first.asString();
+        ScopedJSAtom atom(context, JS_NewAtomLen(context, key.data(), key.size()));
+        if (atom.get() == JS_ATOM_NULL) {
+          JS_FreeValue(context, property);
+          JS_FreeValue(context, object);
+          return JS_EXCEPTION;
+        }
+        if (JS_DefinePropertyValue(context, object, atom.get(), property, JS_PROP_C_W_E) < 0) {
+          JS_FreeValue(context, object);
+          return JS_EXCEPTION;
+        }
+      }
+      return object;
+    }
+  }
+  return JS_UNDEFINED;
+}
+
+} // namespace qjs
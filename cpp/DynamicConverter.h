@@ -0,0 +1,49 @@
+#pragma once
+
+#include <folly/dynamic.h>
+
+#include "QuickJSRuntime.h"
+#include "jsi/jsi.h"
+
+namespace qjs {
+
+// Converts between folly::dynamic and values of a QuickJSRuntime, with the
+// results of jsi::dynamicFromValue/valueFromDynamic. Objects are read from
+// their shape and arrays from their elements when possible, without going
+// through jsi::Object and property name arrays.
+class DynamicConverter {
+ private:
+  DynamicConverter() = delete;
+  ~DynamicConverter() = delete;
+  DynamicConverter(DynamicConverter &&) = delete;
+
+ public:
+  static folly::dynamic ToDynamic(
+      const QuickJSRuntime &runtime,
+      const jsi::Value &value);
+
+  static jsi::Value ToJSIValue(
+      const QuickJSRuntime &runtime,
+      const folly::dynamic &dynamic);
+
+ private:
+  static folly::dynamic ToDynamic(
+      const QuickJSRuntime &runtime,
+      JSValueConst value,
+      int depth);
+
+  static folly::dynamic ArrayToDynamic(
+      const QuickJSRuntime &runtime,
+      JSValueConst array,
+      int depth);
+
+  static folly::dynamic ObjectToDynamic(
+      const QuickJSRuntime &runtime,
+      JSValueConst object,
+      int depth);
+
+  // Returns JS_EXCEPTION on failure.
+  static JSValue ToJSValue(JSContext *context, const folly::dynamic &dynamic);
+};
+
+} // namespace qjs
@@ -0,0 +1,55 @@
+#include "FastHostFunction.h"
+
+namespace qjs {
+
+JSClassID FastHostFunctionProxy::kJSClassID = 0;
+
+JSClassDef FastHostFunctionProxy::kJSClassDef = {
+    .class_name = "FastHostFunctionProxy",
+    .finalizer = &FastHostFunctionProxy::Finalizer,
+    .call = &FastHostFunctionProxy::FunctionCallback,
+};
+
+FastHostFunctionProxy::FastHostFunctionProxy() {
+  opaqueData_.hostData_ = this;
+}
+
+OpaqueData *FastHostFunctionProxy::GetOpaqueData() {
+  return &opaqueData_;
+}
+
+JSClassID FastHostFunctionProxy::GetClassID() {
+  if (!kJSClassID) {
+    JS_NewClassID(&kJSClassID);
+  }
+  return kJSClassID;
+}
+
+void FastHostFunctionProxy::Finalizer(JSRuntime *rt, JSValue val) {
+  auto fastHostFunctionProxy =
+      reinterpret_cast<FastHostFunctionProxy *>(OpaqueData::GetHostData(val));
+  delete fastHostFunctionProxy;
+}
+
+JSValue FastHostFunctionProxy::FunctionCallback(
+    JSContext *ctx,
+    JSValueConst func_obj,
+    JSValueConst val,
+    int argc,
+    JSValueConst *argv,
+    int flags) {
+  auto *fastHostFunctionProxy =
+      reinterpret_cast<FastHostFunctionProxy *>(OpaqueData::GetHostData(func_obj));
+  try {
+    return fastHostFunctionProxy->Call(ctx, argc, argv);
+  } catch (const jsi::JSError &error) {
+    auto &runtime = *static_cast<QuickJSRuntime *>(JS_GetRuntimeOpaque(JS_GetRuntime(ctx)));
+    return JS_Throw(ctx, JSIValueConverter::ToJSValue(runtime, error.value()));
+  } catch (const std::exception &ex) {
+    return JS_ThrowInternalError(ctx, "%s", ex.what());
+  } catch (...) {
+    return JS_ThrowInternalError(ctx, "Unknown exception in host function");
+  }
+}
+
+} // namespace qjs
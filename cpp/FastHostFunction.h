@@ -0,0 +1,290 @@
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "HostProxy.h"
+#include "JSIValueConverter.h"
+#include "QuickJSRuntime.h"
+#include "jsi/jsi.h"
+
+namespace qjs {
+
+// Host functions with a typed C++ signature, e.g.
+//
+//   auto lerp = createFastHostFunction<double(double, double, double)>(
+//       runtime, jsi::PropNameID::forAscii(runtime, "lerp"),
+//       [](double a, double b, double t) { return a + (b - a) * t; });
+//
+// The trampoline generated for the signature reads the arguments straight
+// from the JSValues and returns the result as a JSValue, without going
+// through jsi::Value. Supported argument and return types are bool,
+// int32_t, uint32_t, int64_t, float, double, std::string and
+// std::string_view, and void as return type. Numbers and ASCII strings read
+// as std::string_view do not allocate. Missing arguments are undefined and
+// converted like JS would, |this| is not passed.
+
+// Type-erased part, owned by the function object.
+class FastHostFunctionProxy : public OpaqueOwner {
+ public:
+  FastHostFunctionProxy();
+  virtual ~FastHostFunctionProxy() = default;
+
+  OpaqueData *GetOpaqueData() override;
+
+  static JSClassID GetClassID();
+
+  static void Finalizer(JSRuntime *rt, JSValue val);
+
+  static JSValue FunctionCallback(
+      JSContext *ctx,
+      JSValueConst func_obj,
+      JSValueConst val,
+      int argc,
+      JSValueConst *argv,
+      int flags);
+
+  static JSClassDef kJSClassDef;
+
+ protected:
+  // Returns JS_EXCEPTION with a pending exception on failure.
+  virtual JSValue Call(JSContext *ctx, int argc, JSValueConst *argv) = 0;
+
+ private:
+  OpaqueData opaqueData_;
+
+  static JSClassID kJSClassID;
+};
+
+namespace detail {
+
+template <typename T>
+class FastArgument {
+  static_assert(sizeof(T) == 0, "Unsupported fast host function argument type");
+};
+
+template <>
+class FastArgument<bool> {
+ public:
+  bool Read(JSContext *ctx, JSValueConst value) {
+    int result = JS_ToBool(ctx, value);
+    value_ = result > 0;
+    return result >= 0;
+  }
+  bool Get() const {
+    return value_;
+  }
+
+ private:
+  bool value_;
+};
+
+template <>
+class FastArgument<double> {
+ public:
+  bool Read(JSContext *ctx, JSValueConst value) {
+    int tag = JS_VALUE_GET_TAG(value);
+    if (tag == JS_TAG_INT) {
+      value_ = JS_VALUE_GET_INT(value);
+      return true;
+    }
+    if (JS_TAG_IS_FLOAT64(tag)) {
+      value_ = JS_VALUE_GET_FLOAT64(value);
+      return true;
+    }
+    return JS_ToFloat64(ctx, &value_, value) == 0;
+  }
+  double Get() const {
+    return value_;
+  }
+
+ private:
+  double value_;
+};
+
+template <>
+class FastArgument<float> : public FastArgument<double> {
+ public:
+  float Get() const {
+    return static_cast<float>(FastArgument<double>::Get());
+  }
+};
+
+template <>
+class FastArgument<int32_t> {
+ public:
+  bool Read(JSContext *ctx, JSValueConst value) {
+    if (JS_VALUE_GET_TAG(value) == JS_TAG_INT) {
+      value_ = JS_VALUE_GET_INT(value);
+      return true;
+    }
+    return JS_ToInt32(ctx, &value_, value) == 0;
+  }
+  int32_t Get() const {
+    return value_;
+  }
+
+ private:
+  int32_t value_;
+};
+
+template <>
+class FastArgument<uint32_t> : public FastArgument<int32_t> {
+ public:
+  uint32_t Get() const {
+    return static_cast<uint32_t>(FastArgument<int32_t>::Get());
+  }
+};
+
+template <>
+class FastArgument<int64_t> {
+ public:
+  bool Read(JSContext *ctx, JSValueConst value) {
+    if (JS_VALUE_GET_TAG(value) == JS_TAG_INT) {
+      value_ = JS_VALUE_GET_INT(value);
+      return true;
+    }
+    return JS_ToInt64(ctx, &value_, value) == 0;
+  }
+  int64_t Get() const {
+    return value_;
+  }
+
+ private:
+  int64_t value_;
+};
+
+// Points into the string itself when it is ASCII.
+template <>
+class FastArgument<std::string_view> {
+ public:
+  FastArgument() = default;
+  FastArgument(const FastArgument &) = delete;
+  FastArgument &operator=(const FastArgument &) = delete;
+
+  ~FastArgument() {
+    if (str_) {
+      JS_FreeCString(ctx_, str_);
+    }
+  }
+
+  bool Read(JSContext *ctx, JSValueConst value) {
+    ctx_ = ctx;
+    str_ = JS_ToCStringLen(ctx, &length_, value);
+    return str_ != nullptr;
+  }
+  std::string_view Get() const {
+    return std::string_view(str_, length_);
+  }
+
+ private:
+  JSContext *ctx_ = nullptr;
+  const char *str_ = nullptr;
+  size_t length_ = 0;
+};
+
+template <>
+class FastArgument<std::string> : public FastArgument<std::string_view> {
+ public:
+  std::string Get() const {
+    return std::string(FastArgument<std::string_view>::Get());
+  }
+};
+
+inline JSValue ToFastResult(JSContext *ctx, bool result) {
+  return JS_NewBool(ctx, result);
+}
+
+inline JSValue ToFastResult(JSContext *ctx, int32_t result) {
+  return JS_NewInt32(ctx, result);
+}
+
+inline JSValue ToFastResult(JSContext *ctx, uint32_t result) {
+  return JS_NewUint32(ctx, result);
+}
+
+inline JSValue ToFastResult(JSContext *ctx, int64_t result) {
+  return JS_NewInt64(ctx, result);
+}
+
+inline JSValue ToFastResult(JSContext *ctx, double result) {
+  return JSIValueConverter::ToJSNumber(ctx, result);
+}
+
+inline JSValue ToFastResult(JSContext *ctx, float result) {
+  return JSIValueConverter::ToJSNumber(ctx, result);
+}
+
+inline JSValue ToFastResult(JSContext *ctx, std::string_view result) {
+  return JS_NewStringLen(ctx, result.data(), result.size());
+}
+
+inline JSValue ToFastResult(JSContext *ctx, const std::string &result) {
+  return JS_NewStringLen(ctx, result.data(), result.size());
+}
+
+template <typename Signature, typename F>
+class FastHostFunction;
+
+template <typename R, typename... Args, typename F>
+class FastHostFunction<R(Args...), F> : public FastHostFunctionProxy {
+ public:
+  static constexpr unsigned int kParamCount = sizeof...(Args);
+
+  explicit FastHostFunction(F &&func) : func_(std::move(func)) {}
+
+ protected:
+  JSValue Call(JSContext *ctx, int argc, JSValueConst *argv) override {
+    return Invoke(ctx, argc, argv, std::index_sequence_for<Args...>());
+  }
+
+ private:
+  template <size_t... I>
+  JSValue Invoke(JSContext *ctx, int argc, JSValueConst *argv, std::index_sequence<I...>) {
+    std::tuple<FastArgument<std::decay_t<Args>>...> arguments;
+    // Read in order, stops at the first argument that throws.
+    bool read = (std::get<I>(arguments).Read(
+                     ctx, static_cast<int>(I) < argc ? argv[I] : JS_UNDEFINED) &&
+                 ...);
+    if (!read) {
+      return JS_EXCEPTION;
+    }
+    if constexpr (std::is_void_v<R>) {
+      func_(std::get<I>(arguments).Get()...);
+      return JS_UNDEFINED;
+    } else {
+      // Converted as the declared return type, whatever |func_| returns.
+      return ToFastResult(ctx, static_cast<R>(func_(std::get<I>(arguments).Get()...)));
+    }
+  }
+
+  F func_;
+};
+
+} // namespace detail
+
+template <typename Signature, typename F>
+jsi::Function createFastHostFunction(
+    jsi::Runtime &runtime,
+    const jsi::PropNameID &name,
+    F &&func) {
+  using Callable = std::decay_t<F>;
+  using Proxy = detail::FastHostFunction<Signature, Callable>;
+  return static_cast<QuickJSRuntime &>(runtime).createFastHostFunction(
+      name, Proxy::kParamCount, new Proxy(Callable(std::forward<F>(func))));
+}
+
+template <typename R, typename... Args>
+jsi::Function createFastHostFunction(
+    jsi::Runtime &runtime,
+    const jsi::PropNameID &name,
+    R (*func)(Args...)) {
+  return createFastHostFunction<R(Args...)>(runtime, name, func);
+}
+
+} // namespace qjs
@@ -37,7 +37,9 @@ const JSCFunctionListEntry HostObjectProxy::kTemplateInterceptor[] = {
 HostObjectProxy::HostObjectProxy(
     QuickJSRuntime &runtime,
     std::shared_ptr<jsi::HostObject> hostObject)
-    : runtime_(runtime), hostObject_(hostObject) {
+    : runtime_(runtime),
+      hostObject_(hostObject),
+      memoizedHostObject_(dynamic_cast<MemoizedHostObject *>(hostObject.get())) {
   opaqueData_.hostData_ = this;
 }
 
@@ -49,6 +51,15 @@ OpaqueData *HostObjectProxy::GetOpaqueData() {
   return &opaqueData_;
 }
 
+void HostObjectProxy::SetMemoizeAll(bool memoizeAll) {
+  memoizeAll_ = memoizeAll;
+}
+
+bool HostObjectProxy::IsStableProperty(const jsi::PropNameID &name) {
+  return memoizeAll_ ||
+      (memoizedHostObject_ && memoizedHostObject_->isStableProperty(runtime_, name));
+}
+
 JSClassID HostObjectProxy::GetClassID() {
   if (!kJSClassID) {
     JS_NewClassID(&kJSClassID);
@@ -67,8 +78,10 @@ HostObjectProxy::Getter(JSContext *ctx, JSValueConst this_val, JSAtom name) {
   jsi::PropNameID sym = JSIValueConverter::ToJSIPropNameID(runtime, name);
   JS_FreeAtom(ctx, name);
   jsi::Value ret;
+  bool stable;
   try {
     ret = hostObjectProxy->hostObject_->get(runtime, sym);
+    stable = hostObjectProxy->IsStableProperty(sym);
   } catch (const jsi::JSError &error) {
     JS_Throw(ctx, JSIValueConverter::ToJSValue(runtime, error.value()));
     return JS_UNDEFINED;
@@ -77,7 +90,15 @@ HostObjectProxy::Getter(JSContext *ctx, JSValueConst this_val, JSAtom name) {
   } catch (...) {
     return JS_UNDEFINED;
   }
-  return JSIValueConverter::ToJSValue(runtime, ret);
+  JSValue result = JSIValueConverter::ToJSValue(runtime, ret);
+  // The engine reads memoized values before calling the interceptor. Only
+  // on the host object itself, not on objects inheriting from it.
+  if (stable && JS_GetOpaque(this_val, GetClassID()) &&
+      JS_SetMemoizedProperty(ctx, this_val, JSIValueConverter::ToJSAtom(runtime, sym),
+                             JS_DupValue(ctx, result)) < 0) {
+    JS_FreeValue(ctx, JS_GetException(ctx));
+  }
+  return result;
 }
 
 JSValue HostObjectProxy::Setter(
@@ -91,10 +112,13 @@ JSValue HostObjectProxy::Setter(
 
   QuickJSRuntime &runtime = hostObjectProxy->runtime_;
   jsi::PropNameID sym = JSIValueConverter::ToJSIPropNameID(runtime, name);
+  // Drop the memoized value, if any.
+  JS_DeleteMemoizedProperty(ctx, this_val, name);
   JS_FreeAtom(ctx, name);
+  BorrowedPointerValueStorage storage;
   try {
     hostObjectProxy->hostObject_->set(
-        runtime, sym, JSIValueConverter::ToJSIValue(runtime, val));
+        runtime, sym, JSIValueConverter::ToBorrowedJSIValue(runtime, val, &storage));
   } catch (const jsi::JSError &error) {
     JS_Throw(ctx, JSIValueConverter::ToJSValue(runtime, error.value()));
     return JS_UNDEFINED;
@@ -114,20 +138,19 @@ JSValue HostObjectProxy::Enumerator(JSContext *ctx, JSValueConst this_val) {
   QuickJSRuntime &runtime = hostObjectProxy->runtime_;
   auto names = hostObjectProxy->hostObject_->getPropertyNames(runtime);
 
-  auto result = JS_NewArray(ctx);
-  for (uint32_t i = 0; i < names.size(); ++i) {
-    JSValue value = JSIValueConverter::ToJSString(runtime, names[i]);
-    JS_SetPropertyInt64(ctx, result, i, value);
+  std::vector<JSValue> elements(names.size());
+  for (size_t i = 0; i < names.size(); ++i) {
+    elements[i] = JSIValueConverter::ToJSString(runtime, names[i]);
   }
 
-  return result;
+  // Takes over the elements.
+  return JS_NewArrayFrom(ctx, static_cast<uint32_t>(elements.size()), elements.data());
 }
 
 void HostObjectProxy::Finalizer(JSRuntime *rt, JSValue val) {
   auto hostObjectProxy =
       reinterpret_cast<HostObjectProxy *>(OpaqueData::GetHostData(val));
   assert(hostObjectProxy->hostObject_.use_count() == 1);
-  hostObjectProxy->opaqueData_.nativeState_ = nullptr;
   delete hostObjectProxy;
 }
 
@@ -157,7 +180,6 @@ OpaqueData *HostFunctionProxy::GetOpaqueData() {
 void HostFunctionProxy::Finalizer(JSRuntime *rt, JSValue val) {
   auto hostFunctionProxy =
       reinterpret_cast<HostFunctionProxy *>(OpaqueData::GetHostData(val));
-  hostFunctionProxy->opaqueData_.nativeState_ = nullptr;
   delete hostFunctionProxy;
 }
 
@@ -180,24 +202,31 @@ JSValue HostFunctionProxy::FunctionCallback(
 
   auto &runtime = hostFunctionProxy->runtime_;
 
+  // The arguments and |this| borrow the caller's JSValues, which stay alive
+  // for the duration of the call. The storage is declared first so that it
+  // outlives the values.
   const unsigned maxStackArgCount = 8;
+  BorrowedPointerValueStorage stackStorage[maxStackArgCount];
   jsi::Value stackArgs[maxStackArgCount];
+  std::unique_ptr<BorrowedPointerValueStorage[]> heapStorage;
   std::unique_ptr<jsi::Value[]> heapArgs;
+  BorrowedPointerValueStorage *storage;
   jsi::Value *args;
   if (argc > maxStackArgCount) {
+    heapStorage = std::make_unique<BorrowedPointerValueStorage[]>(argc);
     heapArgs = std::make_unique<jsi::Value[]>(argc);
-    for (size_t i = 0; i < argc; i++) {
-      heapArgs[i] = JSIValueConverter::ToJSIValue(runtime, argv[i]);
-    }
+    storage = heapStorage.get();
     args = heapArgs.get();
   } else {
-    for (size_t i = 0; i < argc; i++) {
-      stackArgs[i] = JSIValueConverter::ToJSIValue(runtime, argv[i]);
-    }
+    storage = stackStorage;
     args = stackArgs;
   }
+  for (size_t i = 0; i < argc; i++) {
+    args[i] = JSIValueConverter::ToBorrowedJSIValue(runtime, argv[i], &storage[i]);
+  }
 
-  jsi::Value thisVal(JSIValueConverter::ToJSIValue(runtime, val));
+  BorrowedPointerValueStorage thisStorage;
+  jsi::Value thisVal(JSIValueConverter::ToBorrowedJSIValue(runtime, val, &thisStorage));
   try {
     return JSIValueConverter::ToJSValue(
         runtime,
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "MemoizedHostObject.h"
 #include "QuickJSRuntime.h"
 #include "jsi/jsi.h"
 
@@ -9,7 +10,6 @@ struct OpaqueData {
   static void *GetHostData(JSValueConst this_val);
 
   void *hostData_;
-  std::shared_ptr<facebook::jsi::NativeState> nativeState_;
 };
 
 class OpaqueOwner {
@@ -26,6 +26,10 @@ class HostObjectProxy : public OpaqueOwner {
 
   OpaqueData *GetOpaqueData() override;
 
+  // Memoize all properties, for host objects that can't derive from
+  // MemoizedHostObject.
+  void SetMemoizeAll(bool memoizeAll);
+
   static JSClassID GetClassID();
 
   static JSValue Getter(JSContext *ctx, JSValueConst this_val, JSAtom name);
@@ -41,8 +45,12 @@ class HostObjectProxy : public OpaqueOwner {
   static const JSCFunctionListEntry kTemplateInterceptor[];
 
  private:
+  bool IsStableProperty(const jsi::PropNameID &name);
+
   QuickJSRuntime &runtime_;
   std::shared_ptr<jsi::HostObject> hostObject_;
+  MemoizedHostObject *memoizedHostObject_;
+  bool memoizeAll_ = false;
   OpaqueData opaqueData_;
 
   static JSClassID kJSClassID;
@@ -28,41 +28,57 @@ jsi::Value JSIValueConverter::ToJSIValue(
     }
   }
   if (JS_IsString(value)) {
-    return QuickJSRuntime::make<jsi::String>(new QuickJSPointerValue(jsRuntime, jsContext, value));
+    return QuickJSRuntime::make<jsi::String>(QuickJSPointerValue::Create(jsRuntime, jsContext, value));
   }
   if (JS_IsSymbol(value)) {
-    return QuickJSRuntime::make<jsi::Symbol>(new QuickJSPointerValue(jsRuntime, jsContext, value));
+    return QuickJSRuntime::make<jsi::Symbol>(QuickJSPointerValue::Create(jsRuntime, jsContext, value));
   }
   if (JS_IsObject(value)) {
-    return QuickJSRuntime::make<jsi::Object>(new QuickJSPointerValue(jsRuntime, jsContext, value));
+    return QuickJSRuntime::make<jsi::Object>(QuickJSPointerValue::Create(jsRuntime, jsContext, value));
   }
   if (JS_IsBigInt(jsContext, value) || JS_IsBigDecimal(value) || JS_IsBigFloat(value)) {
-    return QuickJSRuntime::make<jsi::BigInt>(new QuickJSPointerValue(jsRuntime, jsContext, value));
+    return QuickJSRuntime::make<jsi::BigInt>(QuickJSPointerValue::Create(jsRuntime, jsContext, value));
   }
 
   return jsi::Value::undefined();
 }
 
-JSValue JSIValueConverter::ToJSValue(
-    const QuickJSRuntime &constRuntime,
+// static
+jsi::Value JSIValueConverter::ToBorrowedJSIValue(
+    const QuickJSRuntime &runtime,
+    JSValueConst value,
+    BorrowedPointerValueStorage *storage) {
+  if (!JS_VALUE_HAS_REF_COUNT(value)) {
+    return ToJSIValue(runtime, value);
+  }
+  auto jsContext = runtime.getJSContext();
+  if (JS_IsString(value)) {
+    return QuickJSRuntime::make<jsi::String>(QuickJSPointerValue::Borrow(storage, value));
+  }
+  if (JS_IsSymbol(value)) {
+    return QuickJSRuntime::make<jsi::Symbol>(QuickJSPointerValue::Borrow(storage, value));
+  }
+  if (JS_IsObject(value)) {
+    return QuickJSRuntime::make<jsi::Object>(QuickJSPointerValue::Borrow(storage, value));
+  }
+  if (JS_IsBigInt(jsContext, value) || JS_IsBigDecimal(value) || JS_IsBigFloat(value)) {
+    return QuickJSRuntime::make<jsi::BigInt>(QuickJSPointerValue::Borrow(storage, value));
+  }
+
+  return jsi::Value::undefined();
+}
+
+// static
+JSValue JSIValueConverter::ToJSPointerValue(
+    const QuickJSRuntime &runtime,
     const jsi::Value &value) {
-  QuickJSRuntime &runtime = const_cast<QuickJSRuntime &>(constRuntime);
-  auto context = const_cast<JSContext *>(runtime.getJSContext());
-  if (value.isUndefined()) {
-    return JS_UNDEFINED;
-  } else if (value.isNull()) {
-    return JS_NULL;
-  } else if (value.isBool()) {
-    return JS_NewBool(context, value.getBool());
-  } else if (value.isNumber()) {
-    return JS_NewFloat64(context, value.getNumber());
-  } else if (value.isString()) {
-    auto str = value.getString(runtime).utf8(runtime);
-    return JS_NewStringLen(context, str.c_str(), str.size());
-  } else if (value.isObject()) {
-    return ToJSObject(runtime, value.getObject(runtime));
-  } else if (value.isBigInt()) {
-    return ToJSBigInt(runtime, value.getBigInt(runtime));
+  auto context = runtime.getJSContext();
+  if (value.isString() || value.isSymbol() || value.isObject() || value.isBigInt()) {
+    // The value already wraps a JSValue of this runtime, share it instead of
+    // going through a jsi::String/Object copy or a UTF-8 round trip.
+    const QuickJSPointerValue *quickJSPointerValue =
+        static_cast<const QuickJSPointerValue *>(runtime.getPointerValue(value));
+    return quickJSPointerValue->Get(context);
   } else {
     // What are you?
     std::abort();
@@ -82,11 +98,15 @@ JSValue JSIValueConverter::ToJSString(
 JSValue JSIValueConverter::ToJSString(
     const QuickJSRuntime &runtime,
     const jsi::PropNameID &propName) {
-  const QuickJSPointerValue *quickJSPointerValue =
-      static_cast<const QuickJSPointerValue *>(runtime.getPointerValue(propName));
-  auto jsObject = quickJSPointerValue->Get(runtime.getJSContext());
-  assert(JS_IsString(jsObject));
-  return jsObject;
+  return JS_AtomToString(runtime.getJSContext(), ToJSAtom(runtime, propName));
+}
+
+JSAtom JSIValueConverter::ToJSAtom(
+    const QuickJSRuntime &runtime,
+    const jsi::PropNameID &propName) {
+  const QuickJSAtomPointerValue *quickJSAtomPointerValue =
+      static_cast<const QuickJSAtomPointerValue *>(runtime.getPointerValue(propName));
+  return quickJSAtomPointerValue->Get();
 }
 
 JSValue JSIValueConverter::ToJSSymbol(
@@ -142,10 +162,8 @@ JSValue JSIValueConverter::ToJSFunction(
 jsi::PropNameID JSIValueConverter::ToJSIPropNameID(
     const QuickJSRuntime &runtime,
     const JSAtom &property) {
-  JSValue jsValue = JS_AtomToValue(runtime.getJSContext(), property);
-  ScopedJSValue scopeJsValue(runtime.getJSContext(), &jsValue);
-  return runtime.make<jsi::PropNameID>(
-      new QuickJSPointerValue(runtime.getJSRuntime(), runtime.getJSContext(), jsValue));
+  return runtime.make<jsi::PropNameID>(QuickJSAtomPointerValue::Create(
+      runtime.getJSRuntime(), JS_DupAtom(runtime.getJSContext(), property)));
 }
 
 std::string JSIValueConverter::ToSTLString(
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cmath>
+#include <cstdint>
+
+#include "QuickJSPointerValue.h"
 #include "QuickJSRuntime.h"
 #include "jsi/jsi.h"
 
@@ -16,7 +20,48 @@ class JSIValueConverter {
       const QuickJSRuntime &runtime,
       const JSValueConst &value);
 
+  // Same as ToJSIValue(), but strings, symbols, objects and BigInts refer to
+  // |value| through a QuickJSPointerValue::Borrow()ed from |storage| instead
+  // of owning a reference. For arguments that are only used during a call,
+  // copying the result with jsi::Value(runtime, value) or getObject() etc.
+  // makes an owning handle.
+  static jsi::Value ToBorrowedJSIValue(
+      const QuickJSRuntime &runtime,
+      JSValueConst value,
+      BorrowedPointerValueStorage *storage);
+
+  // Primitives are converted inline, only values wrapping a JSValue go
+  // through ToJSPointerValue.
   static JSValue ToJSValue(
+      const QuickJSRuntime &runtime,
+      const jsi::Value &value) {
+    if (value.isUndefined()) {
+      return JS_UNDEFINED;
+    } else if (value.isNull()) {
+      return JS_NULL;
+    } else if (value.isBool()) {
+      return JS_NewBool(runtime.getJSContext(), value.getBool());
+    } else if (value.isNumber()) {
+      return ToJSNumber(runtime.getJSContext(), value.getNumber());
+    }
+    return ToJSPointerValue(runtime, value);
+  }
+
+  // Integral numbers in int32 range become JS_TAG_INT, which keeps the
+  // interpreter on its int paths for arithmetic, comparisons and fast array
+  // indexing. JS_NewFloat64 tries the same through an int32_t cast, which
+  // is undefined for doubles out of that range such as timestamps.
+  static JSValue ToJSNumber(JSContext *context, double number) {
+    if (number >= INT32_MIN && number <= INT32_MAX) {
+      auto integer = static_cast<int32_t>(number);
+      if (integer == number && (integer != 0 || !std::signbit(number))) {
+        return JS_NewInt32(context, integer);
+      }
+    }
+    return __JS_NewFloat64(context, number);
+  }
+
+  static JSValue ToJSPointerValue(
       const QuickJSRuntime &runtime,
       const jsi::Value &value);
 
@@ -28,6 +73,11 @@ class JSIValueConverter {
       const QuickJSRuntime &runtime,
       const jsi::PropNameID &propName);
 
+  // Borrowed from |propName|, not to be freed.
+  static JSAtom ToJSAtom(
+      const QuickJSRuntime &runtime,
+      const jsi::PropNameID &propName);
+
   static JSValue ToJSSymbol(
       const QuickJSRuntime &runtime,
       const jsi::Symbol &symbol);
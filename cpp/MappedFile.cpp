@@ -0,0 +1,49 @@
+#include "MappedFile.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace qjs {
+
+// static
+std::unique_ptr<MappedFile> MappedFile::map(int fd, size_t offset, size_t size) {
+  static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t alignedOffset = offset & ~(pageSize - 1);
+  size_t length = size + (offset - alignedOffset);
+
+  // MAP_PRIVATE + PROT_WRITE so the reader can patch the atoms it
+  // relocates. The pages it writes become private dirty memory.
+  void *addr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, alignedOffset);
+  if (addr == MAP_FAILED) {
+    return nullptr;
+  }
+
+  return std::unique_ptr<MappedFile>(new MappedFile(
+      addr, length, static_cast<uint8_t *>(addr) + (offset - alignedOffset), size));
+}
+
+// static
+std::unique_ptr<MappedFile> MappedFile::allocate(size_t size) {
+  void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED) {
+    return nullptr;
+  }
+  return std::unique_ptr<MappedFile>(
+      new MappedFile(addr, size, static_cast<uint8_t *>(addr), size));
+}
+
+void MappedFile::advise(size_t offset, size_t size, int advice) const {
+  static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  uintptr_t start = reinterpret_cast<uintptr_t>(data_) + offset;
+  uintptr_t end = start + size;
+  start &= ~(pageSize - 1);
+  if (end > start) {
+    madvise(reinterpret_cast<void *>(start), end - start, advice);
+  }
+}
+
+MappedFile::~MappedFile() {
+  munmap(base_, length_);
+}
+
+} // namespace qjs
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+namespace qjs {
+
+// A private, copy-on-write mapping of a range of a file. Pages are faulted
+// in lazily. Pages that are never written stay clean, so the OS can share or
+// evict them like any other file-backed page. Written pages become private
+// dirty memory. For a code cache read in place, that is nearly every page
+// holding bytecode, since almost every atom in it is relocated. Also holds
+// anonymous memory standing in for a file, e.g. a decompressed cache.
+class MappedFile {
+ public:
+  // Maps |size| bytes of |fd| at |offset|, which needs no alignment.
+  static std::unique_ptr<MappedFile> map(int fd, size_t offset, size_t size);
+
+  // Maps |size| bytes of zeroed anonymous memory.
+  static std::unique_ptr<MappedFile> allocate(size_t size);
+
+  ~MappedFile();
+
+  // Prevent copying of the mapping.
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  uint8_t *data() const {
+    return data_;
+  };
+
+  size_t size() const {
+    return size_;
+  };
+
+  // madvise() |size| bytes at |offset| of the mapped range.
+  void advise(size_t offset, size_t size, int advice) const;
+
+ private:
+  MappedFile(void *base, size_t length, uint8_t *data, size_t size)
+      : base_(base), length_(length), data_(data), size_(size) {};
+
+  void *base_;
+  size_t length_;
+  uint8_t *data_;
+  size_t size_;
+};
+
+} // namespace qjs
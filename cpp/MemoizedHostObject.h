@@ -0,0 +1,20 @@
+#pragma once
+
+#include "jsi/jsi.h"
+
+namespace qjs {
+
+// Host objects deriving from this class let the runtime keep the value
+// returned by get() for their stable properties, typically methods. The
+// value is stored in the memo table of the JS object, apart from its
+// properties, and later reads of the property don't call into C++ at all.
+// Setting the property from JS, or calling
+// QuickJSRuntime::invalidateHostObjectProperty(), drops it again.
+class MemoizedHostObject : public facebook::jsi::HostObject {
+ public:
+  virtual bool isStableProperty(
+      facebook::jsi::Runtime &runtime,
+      const facebook::jsi::PropNameID &name) = 0;
+};
+
+} // namespace qjs
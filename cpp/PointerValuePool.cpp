@@ -0,0 +1,16 @@
+#include "PointerValuePool.h"
+
+namespace qjs {
+
+void PointerValuePool::grow() {
+  std::unique_ptr<Slot[]> slab(new Slot[kSlotsPerSlab]);
+  // Thread the new slots in address order, so consecutive handles are
+  // adjacent in memory.
+  for (size_t i = kSlotsPerSlab; i > 0; i--) {
+    slab[i - 1].next = freeList_;
+    freeList_ = &slab[i - 1];
+  }
+  slabs_.push_back(std::move(slab));
+}
+
+} // namespace qjs
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace qjs {
+
+// Storage for the pointer values of a runtime. Every handle crossing JSI is a
+// pointer value, so instead of a malloc/free pair per handle, slots are
+// carved out of slabs and recycled through a free list. Slabs are only
+// released with the pool. JS thread only, like the runtime.
+class PointerValuePool {
+ public:
+  static constexpr size_t kSlotSize = 4 * sizeof(void *);
+  static constexpr size_t kSlotsPerSlab = 512;
+
+  PointerValuePool() = default;
+
+  // Prevent copying of the pool.
+  PointerValuePool(const PointerValuePool &) = delete;
+  PointerValuePool &operator=(const PointerValuePool &) = delete;
+
+  void *allocate() {
+    if (!freeList_) {
+      grow();
+    }
+    Slot *slot = freeList_;
+    freeList_ = slot->next;
+    allocationCount_++;
+    if (++liveCount_ > peakLiveCount_) {
+      peakLiveCount_ = liveCount_;
+    }
+    return slot;
+  }
+
+  void free(void *ptr) {
+    Slot *slot = static_cast<Slot *>(ptr);
+    slot->next = freeList_;
+    freeList_ = slot;
+    liveCount_--;
+  }
+
+  uint64_t allocationCount() const {
+    return allocationCount_;
+  };
+
+  size_t liveCount() const {
+    return liveCount_;
+  };
+
+  size_t peakLiveCount() const {
+    return peakLiveCount_;
+  };
+
+  size_t slabCount() const {
+    return slabs_.size();
+  };
+
+ private:
+  union alignas(alignof(std::max_align_t)) Slot {
+    Slot *next;
+    unsigned char storage[kSlotSize];
+  };
+
+  void grow();
+
+  std::vector<std::unique_ptr<Slot[]>> slabs_;
+  Slot *freeList_ = nullptr;
+  uint64_t allocationCount_ = 0;
+  size_t liveCount_ = 0;
+  size_t peakLiveCount_ = 0;
+};
+
+} // namespace qjs
@@ -0,0 +1,257 @@
+#include "QuickJSExecutor.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <cxxreact/ModuleRegistry.h>
+#include <cxxreact/ReactMarker.h>
+#include <cxxreact/SystraceSection.h>
+
+#include "DynamicConverter.h"
+
+namespace qjs {
+
+// Same as react::JSINativeModules, with the module configs converted by
+// DynamicConverter.
+class QuickJSNativeModules {
+ public:
+  explicit QuickJSNativeModules(std::shared_ptr<react::ModuleRegistry> moduleRegistry)
+      : moduleRegistry_(std::move(moduleRegistry)) {}
+
+  jsi::Value getModule(QuickJSRuntime &runtime, const jsi::PropNameID &name) {
+    if (!moduleRegistry_) {
+      return nullptr;
+    }
+    std::string moduleName = name.utf8(runtime);
+    auto it = modules_.find(moduleName);
+    if (it == modules_.end()) {
+      jsi::Value module = createModule(runtime, moduleName);
+      if (module.isNull()) {
+        return nullptr;
+      }
+      it = modules_.emplace(std::move(moduleName), std::move(module)).first;
+    }
+    return jsi::Value(runtime, it->second);
+  }
+
+ private:
+  jsi::Value createModule(QuickJSRuntime &runtime, const std::string &name) {
+    react::ReactMarker::logTaggedMarker(
+        react::ReactMarker::NATIVE_MODULE_SETUP_START, name.c_str());
+    if (!genNativeModuleJS_) {
+      genNativeModuleJS_ = std::make_unique<jsi::Function>(
+          runtime.global().getPropertyAsFunction(runtime, "__fbGenNativeModule"));
+    }
+    auto config = moduleRegistry_->getConfig(name);
+    if (!config) {
+      return nullptr;
+    }
+    jsi::Value moduleInfo = genNativeModuleJS_->call(
+        runtime,
+        DynamicConverter::ToJSIValue(runtime, config->config),
+        static_cast<double>(config->index));
+    if (!moduleInfo.isObject()) {
+      throw jsi::JSINativeException("Module returned from genNativeModule isn't an Object");
+    }
+    jsi::Value module = moduleInfo.asObject(runtime).getProperty(runtime, "module");
+    react::ReactMarker::logTaggedMarker(
+        react::ReactMarker::NATIVE_MODULE_SETUP_STOP, name.c_str());
+    return module;
+  }
+
+  std::shared_ptr<react::ModuleRegistry> moduleRegistry_;
+  std::unique_ptr<jsi::Function> genNativeModuleJS_;
+  std::unordered_map<std::string, jsi::Value> modules_;
+};
+
+// The runtime owns the proxy and can outlive the executor.
+class QuickJSExecutor::NativeModuleProxy : public jsi::HostObject {
+ public:
+  explicit NativeModuleProxy(std::shared_ptr<QuickJSNativeModules> nativeModules)
+      : weakNativeModules_(nativeModules) {}
+
+  jsi::Value get(jsi::Runtime &runtime, const jsi::PropNameID &name) override {
+    if (name.utf8(runtime) == "name") {
+      return jsi::String::createFromAscii(runtime, "NativeModules");
+    }
+    auto nativeModules = weakNativeModules_.lock();
+    if (!nativeModules) {
+      return nullptr;
+    }
+    return nativeModules->getModule(static_cast<QuickJSRuntime &>(runtime), name);
+  }
+
+  void set(jsi::Runtime &, const jsi::PropNameID &, const jsi::Value &) override {
+    throw std::runtime_error("Unable to put on NativeModules: Operation unsupported");
+  }
+
+ private:
+  std::weak_ptr<QuickJSNativeModules> weakNativeModules_;
+};
+
+QuickJSExecutor::QuickJSExecutor(
+    std::shared_ptr<jsi::Runtime> runtime,
+    std::shared_ptr<react::ExecutorDelegate> delegate,
+    const react::JSIScopedTimeoutInvoker &timeoutInvoker,
+    RuntimeInstaller runtimeInstaller)
+    : JSIExecutor(runtime, delegate, timeoutInvoker, std::move(runtimeInstaller)),
+      runtime_(static_cast<QuickJSRuntime &>(*runtime)),
+      delegate_(delegate),
+      nativeModules_(std::make_shared<QuickJSNativeModules>(
+          delegate ? delegate->getModuleRegistry() : nullptr)),
+      timeoutInvoker_(timeoutInvoker) {}
+
+void QuickJSExecutor::initializeRuntime() {
+  react::SystraceSection s("QuickJSExecutor::initializeRuntime");
+  JSIExecutor::initializeRuntime();
+
+  // Replace the bindings of JSIExecutor that convert through folly::dynamic.
+  runtime_.global().setProperty(
+      runtime_,
+      "nativeModuleProxy",
+      jsi::Object::createFromHostObject(
+          runtime_, std::make_shared<NativeModuleProxy>(nativeModules_)));
+
+  runtime_.global().setProperty(
+      runtime_,
+      "nativeFlushQueueImmediate",
+      jsi::Function::createFromHostFunction(
+          runtime_,
+          jsi::PropNameID::forAscii(runtime_, "nativeFlushQueueImmediate"),
+          1,
+          [this](jsi::Runtime &, const jsi::Value &, const jsi::Value *args, size_t count) {
+            if (count != 1) {
+              throw std::invalid_argument("nativeFlushQueueImmediate arg count must be 1");
+            }
+            callNativeModules(args[0], false);
+            return jsi::Value::undefined();
+          }));
+
+  runtime_.global().setProperty(
+      runtime_,
+      "nativeCallSyncHook",
+      jsi::Function::createFromHostFunction(
+          runtime_,
+          jsi::PropNameID::forAscii(runtime_, "nativeCallSyncHook"),
+          1,
+          [this](jsi::Runtime &, const jsi::Value &, const jsi::Value *args, size_t count) {
+            return nativeCallSyncHook(args, count);
+          }));
+}
+
+void QuickJSExecutor::callFunction(
+    const std::string &moduleId,
+    const std::string &methodId,
+    const folly::dynamic &arguments) {
+  react::SystraceSection s(
+      "QuickJSExecutor::callFunction", "moduleId", moduleId, "methodId", methodId);
+  if (!callFunctionReturnFlushedQueue_) {
+    bindBridge();
+  }
+
+  auto errorProducer = [=] {
+    std::stringstream ss;
+    ss << "moduleID: " << moduleId << " methodID: " << methodId;
+    return ss.str();
+  };
+
+  jsi::Value ret = jsi::Value::undefined();
+  try {
+    timeoutInvoker_(
+        [&] {
+          ret = callFunctionReturnFlushedQueue_->call(
+              runtime_,
+              moduleId,
+              methodId,
+              DynamicConverter::ToJSIValue(runtime_, arguments));
+        },
+        std::move(errorProducer));
+  } catch (...) {
+    std::throw_with_nested(
+        std::runtime_error("Error calling " + moduleId + "." + methodId));
+  }
+
+  callNativeModules(ret, true);
+}
+
+void QuickJSExecutor::invokeCallback(
+    const double callbackId,
+    const folly::dynamic &arguments) {
+  react::SystraceSection s("QuickJSExecutor::invokeCallback", "callbackId", callbackId);
+  if (!invokeCallbackAndReturnFlushedQueue_) {
+    bindBridge();
+  }
+
+  jsi::Value ret = jsi::Value::undefined();
+  try {
+    ret = invokeCallbackAndReturnFlushedQueue_->call(
+        runtime_, callbackId, DynamicConverter::ToJSIValue(runtime_, arguments));
+  } catch (...) {
+    std::throw_with_nested(std::runtime_error(
+        "Error invoking callback " + std::to_string(callbackId)));
+  }
+
+  callNativeModules(ret, true);
+}
+
+void QuickJSExecutor::flush() {
+  react::SystraceSection s("QuickJSExecutor::flush");
+  if (flushedQueue_) {
+    callNativeModules(flushedQueue_->call(runtime_), true);
+    return;
+  }
+
+  // __fbBatchedBridge is only set once JS called a native module, there is
+  // nothing to flush before that.
+  jsi::Value batchedBridge = runtime_.global().getProperty(runtime_, "__fbBatchedBridge");
+  if (!batchedBridge.isUndefined()) {
+    bindBridge();
+    callNativeModules(flushedQueue_->call(runtime_), true);
+  } else if (delegate_) {
+    callNativeModules(nullptr, true);
+  }
+}
+
+void QuickJSExecutor::bindBridge() {
+  react::SystraceSection s("QuickJSExecutor::bindBridge");
+  jsi::Value batchedBridgeValue = runtime_.global().getProperty(runtime_, "__fbBatchedBridge");
+  if (!batchedBridgeValue.isObject()) {
+    throw jsi::JSINativeException(
+        "Could not get BatchedBridge, make sure your bundle is packaged correctly");
+  }
+
+  jsi::Object batchedBridge = batchedBridgeValue.asObject(runtime_);
+  callFunctionReturnFlushedQueue_ = std::make_unique<jsi::Function>(
+      batchedBridge.getPropertyAsFunction(runtime_, "callFunctionReturnFlushedQueue"));
+  invokeCallbackAndReturnFlushedQueue_ = std::make_unique<jsi::Function>(
+      batchedBridge.getPropertyAsFunction(runtime_, "invokeCallbackAndReturnFlushedQueue"));
+  flushedQueue_ = std::make_unique<jsi::Function>(
+      batchedBridge.getPropertyAsFunction(runtime_, "flushedQueue"));
+}
+
+void QuickJSExecutor::callNativeModules(const jsi::Value &queue, bool isEndOfBatch) {
+  react::SystraceSection s("QuickJSExecutor::callNativeModules");
+  delegate_->callNativeModules(
+      *this, DynamicConverter::ToDynamic(runtime_, queue), isEndOfBatch);
+}
+
+jsi::Value QuickJSExecutor::nativeCallSyncHook(const jsi::Value *args, size_t count) {
+  if (count != 3) {
+    throw std::invalid_argument("nativeCallSyncHook arg count must be 3");
+  }
+  if (!args[2].asObject(runtime_).isArray(runtime_)) {
+    throw std::invalid_argument("method parameters should be array");
+  }
+
+  auto moduleId = static_cast<unsigned int>(args[0].getNumber());
+  auto methodId = static_cast<unsigned int>(args[1].getNumber());
+  auto result = delegate_->callSerializableNativeHook(
+      *this, moduleId, methodId, DynamicConverter::ToDynamic(runtime_, args[2]));
+  if (!result) {
+    return jsi::Value::undefined();
+  }
+  return DynamicConverter::ToJSIValue(runtime_, *result);
+}
+
+} // namespace qjs
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <jsireact/JSIExecutor.h>
+
+#include "QuickJSRuntime.h"
+
+namespace jsi = facebook::jsi;
+namespace react = facebook::react;
+
+namespace qjs {
+
+class QuickJSNativeModules;
+
+// JSIExecutor whose bridge traffic, the calls into JS, the native module
+// call queues and the module configs, is converted by DynamicConverter
+// instead of jsi::dynamicFromValue/valueFromDynamic. |runtime| must be
+// created by createQuickJSRuntime().
+class QuickJSExecutor : public react::JSIExecutor {
+ public:
+  QuickJSExecutor(
+      std::shared_ptr<jsi::Runtime> runtime,
+      std::shared_ptr<react::ExecutorDelegate> delegate,
+      const react::JSIScopedTimeoutInvoker &timeoutInvoker,
+      RuntimeInstaller runtimeInstaller);
+
+  void initializeRuntime() override;
+
+  void callFunction(
+      const std::string &moduleId,
+      const std::string &methodId,
+      const folly::dynamic &arguments) override;
+
+  void invokeCallback(
+      const double callbackId,
+      const folly::dynamic &arguments) override;
+
+  void flush() override;
+
+ private:
+  class NativeModuleProxy;
+
+  void bindBridge();
+  void callNativeModules(const jsi::Value &queue, bool isEndOfBatch);
+  jsi::Value nativeCallSyncHook(const jsi::Value *args, size_t count);
+
+  QuickJSRuntime &runtime_;
+  std::shared_ptr<react::ExecutorDelegate> delegate_;
+  std::shared_ptr<QuickJSNativeModules> nativeModules_;
+  react::JSIScopedTimeoutInvoker timeoutInvoker_;
+  std::unique_ptr<jsi::Function> callFunctionReturnFlushedQueue_;
+  std::unique_ptr<jsi::Function> invokeCallbackAndReturnFlushedQueue_;
+  std::unique_ptr<jsi::Function> flushedQueue_;
+};
+
+} // namespace qjs
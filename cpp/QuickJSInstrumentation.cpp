@@ -10,7 +10,15 @@ std::string QuickJSInstrumentation::getRecordedGCStats() {
 
 std::unordered_map<std::string, int64_t> QuickJSInstrumentation::getHeapInfo(bool) {
   if (runtime_) {
-    return runtime_->getHeapInfo();
+    auto heapInfo = runtime_->getHeapInfo();
+    const PointerValuePool &pool = runtime_->getPointerValuePool();
+    heapInfo["pointer_value_allocations"] = pool.allocationCount();
+    heapInfo["pointer_value_count"] = pool.liveCount();
+    heapInfo["pointer_value_peak_count"] = pool.peakLiveCount();
+    heapInfo["pointer_value_slab_count"] = pool.slabCount();
+    heapInfo["pointer_value_slab_size"] =
+        pool.slabCount() * PointerValuePool::kSlotsPerSlab * PointerValuePool::kSlotSize;
+    return heapInfo;
   } else {
     return {};
   }
@@ -1,13 +1,43 @@
 #include "QuickJSPointerValue.h"
 
+#include <new>
+
+#include "PointerValuePool.h"
+
 namespace qjs {
 
+static_assert(sizeof(QuickJSPointerValue) <= PointerValuePool::kSlotSize,
+              "QuickJSPointerValue must fit in a pool slot");
+static_assert(sizeof(QuickJSAtomPointerValue) <= PointerValuePool::kSlotSize,
+              "QuickJSAtomPointerValue must fit in a pool slot");
+
+static PointerValuePool &GetPool(JSRuntime *runtime) {
+  return static_cast<QuickJSRuntime *>(JS_GetRuntimeOpaque(runtime))->getPointerValuePool();
+}
+
+// static
+QuickJSPointerValue *QuickJSPointerValue::Create(
+    JSRuntime *runtime, JSContext *context, JSValue value) {
+  return new (GetPool(runtime).allocate()) QuickJSPointerValue(runtime, context, value);
+}
+
+// static
+QuickJSPointerValue *QuickJSPointerValue::Borrow(void *storage, JSValueConst value) {
+  return new (storage) QuickJSPointerValue(value);
+}
+
 QuickJSPointerValue::QuickJSPointerValue(JSRuntime *runtime, JSContext *context, JSValue value)
     : runtime_(runtime), value_(JS_DupValue(context, value)) {
 }
 
+QuickJSPointerValue::QuickJSPointerValue(JSValueConst value)
+    : runtime_(nullptr), value_(value) {
+}
+
 QuickJSPointerValue::~QuickJSPointerValue() {
-  JS_FreeValueRT(runtime_, value_);
+  if (runtime_) {
+    JS_FreeValueRT(runtime_, value_);
+  }
 }
 
 JSValue QuickJSPointerValue::Get(JSContext *context) const {
@@ -15,7 +45,31 @@ JSValue QuickJSPointerValue::Get(JSContext *context) const {
 }
 
 void QuickJSPointerValue::invalidate() {
-  delete this;
+  if (!runtime_) {
+    return;
+  }
+  PointerValuePool &pool = GetPool(runtime_);
+  this->~QuickJSPointerValue();
+  pool.free(this);
+}
+
+// static
+QuickJSAtomPointerValue *QuickJSAtomPointerValue::Create(JSRuntime *runtime, JSAtom atom) {
+  return new (GetPool(runtime).allocate()) QuickJSAtomPointerValue(runtime, atom);
+}
+
+QuickJSAtomPointerValue::QuickJSAtomPointerValue(JSRuntime *runtime, JSAtom atom)
+    : runtime_(runtime), atom_(atom) {
+}
+
+QuickJSAtomPointerValue::~QuickJSAtomPointerValue() {
+  JS_FreeAtomRT(runtime_, atom_);
+}
+
+void QuickJSAtomPointerValue::invalidate() {
+  PointerValuePool &pool = GetPool(runtime_);
+  this->~QuickJSAtomPointerValue();
+  pool.free(this);
 }
 
 } // namespace qjs
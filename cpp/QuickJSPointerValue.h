@@ -1,18 +1,31 @@
 #pragma once
 
+#include <type_traits>
+
 #include "QuickJSRuntime.h"
 #include "jsi/jsi.h"
 
 namespace qjs {
 
+// Pointer values are allocated from the PointerValuePool of their runtime,
+// through Create(), and go back to it once invalidated.
 class QuickJSPointerValue final : public QuickJSRuntime::PointerValue {
  public:
-  QuickJSPointerValue(JSRuntime *runtime, JSContext *context, JSValue value);
-  ~QuickJSPointerValue();
+  static QuickJSPointerValue *Create(JSRuntime *runtime, JSContext *context, JSValue value);
+
+  // Constructs in |storage| a pointer value that refers to |value| without
+  // taking a reference. It is only valid as long as |value| is, invalidating
+  // it does nothing and |storage| stays owned by the caller. Clones own their
+  // value as usual.
+  static QuickJSPointerValue *Borrow(void *storage, JSValueConst value);
 
   JSValue Get(JSContext *context) const;
 
  private:
+  QuickJSPointerValue(JSRuntime *runtime, JSContext *context, JSValue value);
+  explicit QuickJSPointerValue(JSValueConst value);
+  ~QuickJSPointerValue();
+
   void invalidate() override;
 
  private:
@@ -20,8 +33,35 @@ class QuickJSPointerValue final : public QuickJSRuntime::PointerValue {
   friend class ScopedJSValue;
   friend class QuickJSRuntime;
 
+  // Null for borrowed values.
   JSRuntime *runtime_;
   JSValue value_;
 };
 
+using BorrowedPointerValueStorage =
+    std::aligned_storage_t<sizeof(QuickJSPointerValue), alignof(QuickJSPointerValue)>;
+
+// Backs PropNameIDs with an interned atom, so property accesses use it as is
+// instead of converting and interning the name every time.
+class QuickJSAtomPointerValue final : public QuickJSRuntime::PointerValue {
+ public:
+  // Takes over the reference to |atom|.
+  static QuickJSAtomPointerValue *Create(JSRuntime *runtime, JSAtom atom);
+
+  // The atom stays owned by the pointer value.
+  JSAtom Get() const {
+    return atom_;
+  };
+
+ private:
+  QuickJSAtomPointerValue(JSRuntime *runtime, JSAtom atom);
+  ~QuickJSAtomPointerValue();
+
+  void invalidate() override;
+
+ private:
+  JSRuntime *runtime_;
+  JSAtom atom_;
+};
+
 } // namespace qjs
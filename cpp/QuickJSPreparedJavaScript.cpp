@@ -0,0 +1,75 @@
+#include "QuickJSPreparedJavaScript.h"
+
+#include <vector>
+
+#include "quickjs.h"
+#include "BytecodeBundle.h"
+
+namespace qjs {
+
+namespace {
+
+class BytecodeBuffer : public jsi::Buffer {
+ public:
+  explicit BytecodeBuffer(std::vector<uint8_t> data) : data_(std::move(data)) {};
+
+  size_t size() const override {
+    return data_.size();
+  };
+
+  const uint8_t *data() const override {
+    return data_.data();
+  };
+
+ private:
+  std::vector<uint8_t> data_;
+};
+
+} // namespace
+
+// static
+std::shared_ptr<QuickJSPreparedJavaScript> QuickJSPreparedJavaScript::compile(
+    const std::shared_ptr<const jsi::Buffer> &buffer,
+    const std::string &sourceURL) {
+  if (isBytecodeBundle(buffer->data(), buffer->size())) {
+    return std::make_shared<QuickJSPreparedJavaScript>(buffer, sourceURL);
+  }
+
+  JSRuntime *runtime = JS_NewRuntime();
+  if (runtime == nullptr) {
+    return nullptr;
+  }
+  JSContext *context = JS_NewContext(runtime);
+  if (context == nullptr) {
+    JS_FreeRuntime(runtime);
+    return nullptr;
+  }
+
+  std::shared_ptr<QuickJSPreparedJavaScript> prepared;
+  JSValue func = JS_Eval(
+      context,
+      (const char *) buffer->data(),
+      buffer->size(),
+      sourceURL.c_str(),
+      JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+  if (!JS_IsException(func)) {
+    size_t size;
+    uint8_t *buf = JS_WriteObject(context, &size, func, JS_WRITE_OBJ_BYTECODE);
+    if (buf) {
+      std::vector<uint8_t> data;
+      data.reserve(kBytecodeBundleHeaderSize + size);
+      data.insert(data.end(), kBytecodeBundleMagic, kBytecodeBundleMagic + kBytecodeBundleHeaderSize);
+      data.insert(data.end(), buf, buf + size);
+      js_free(context, buf);
+      prepared = std::make_shared<QuickJSPreparedJavaScript>(
+          std::make_shared<BytecodeBuffer>(std::move(data)), sourceURL);
+    }
+  }
+  JS_FreeValue(context, func);
+
+  JS_FreeContext(context);
+  JS_FreeRuntime(runtime);
+  return prepared;
+}
+
+} // namespace qjs
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "jsi/jsi.h"
+
+namespace jsi = facebook::jsi;
+
+namespace qjs {
+
+// A bundle compiled ahead of evaluation. The bytecode is produced in a
+// scratch JSRuntime, so preparing does not touch the runtime it is later
+// evaluated in and can run on any thread.
+class QuickJSPreparedJavaScript : public jsi::PreparedJavaScript {
+ public:
+  // Returns nullptr if |buffer| does not compile; evaluating the source then
+  // reports the error on the JS thread.
+  static std::shared_ptr<QuickJSPreparedJavaScript> compile(
+      const std::shared_ptr<const jsi::Buffer> &buffer,
+      const std::string &sourceURL);
+
+  QuickJSPreparedJavaScript(
+      std::shared_ptr<const jsi::Buffer> bytecode,
+      std::string sourceURL)
+      : bytecode_(std::move(bytecode)), sourceURL_(std::move(sourceURL)) {};
+
+  // The bytecode in the bytecode bundle format, see BytecodeBundle.h.
+  const std::shared_ptr<const jsi::Buffer> &bytecode() const {
+    return bytecode_;
+  };
+
+  const std::string &sourceURL() const {
+    return sourceURL_;
+  };
+
+ private:
+  std::shared_ptr<const jsi::Buffer> bytecode_;
+  std::string sourceURL_;
+};
+
+} // namespace qjs
@@ -1,7 +1,8 @@
 #include "QuickJSRuntime.h"
 
 #include <string.h>
-#include <regex>
+#include <sys/mman.h>
+#include <future>
 #include <iostream>
 
 #include <glog/logging.h>
@@ -12,17 +13,19 @@
 #include "ScopedJSValue.h"
 #include "JSIValueConverter.h"
 #include "HostProxy.h"
+#include "FastHostFunction.h"
 #include <jsi/jsilib.h>
 
 #include "QuickJSInstrumentation.h"
+#include "CodeCacheCompression.h"
+#include "CodeCacheHeader.h"
+#include "CodeCacheStore.h"
+#include "CodeCacheWriter.h"
+#include "BytecodeBundle.h"
+#include "QuickJSPreparedJavaScript.h"
 
-#include <folly/FileUtil.h>
 #include <glog/logging.h>
 
-#if ENABLE_HASH_CHECK
-#include "city.h"
-#endif
-
 namespace qjs {
 
 static void js_dump_obj(JSContext *ctx, JSValueConst val) {
@@ -60,11 +63,23 @@ __maybe_unused void js_std_dump_error(JSContext *ctx) {
   JS_FreeValue(ctx, exception_val);
 }
 
+// The native state slot of an object holds a heap allocated shared_ptr.
+static void FinalizeNativeState(JSRuntime *rt, void *state) {
+  delete static_cast<std::shared_ptr<jsi::NativeState> *>(state);
+}
+
 QuickJSRuntime::QuickJSRuntime(const std::string &codeCacheDir) {
   runtime_ = JS_NewRuntime();
+  // Lets pointer values find the pool of their runtime.
+  JS_SetRuntimeOpaque(runtime_, this);
+  JS_SetNativeStateFinalizer(runtime_, &FinalizeNativeState);
   JS_SetMaxStackSize(runtime_, 1024 * 1024 * 1024);
   context_ = JS_NewContext(runtime_);
   codeCacheDir_ = codeCacheDir;
+  if (!codeCacheDir_.empty()) {
+    // Opening the store starts prefetching the entries used at startup.
+    codeCacheStore_ = &CodeCacheStore::get(codeCacheDir_);
+  }
   if (context_ == nullptr) {
     JS_FreeRuntime(runtime_);
   }
@@ -76,16 +91,12 @@ QuickJSRuntime::QuickJSRuntime(const std::string &codeCacheDir) {
 }
 
 QuickJSRuntime::~QuickJSRuntime() {
-  for (;;) {
-    JSContext *ctx1;
-    int ret = JS_ExecutePendingJob(JS_GetRuntime(context_), &ctx1);
-    if (ret < 0) {
-      checkAndThrowException(context_);
-    } else if (ret == 0) {
-      break;
-    }
-  }
+  alive_.reset();
+  runMicrotasks(-1);
 
+  for (auto &pending : pendingCodeCaches_) {
+    JS_FreeValue(context_, pending.func);
+  }
   JS_FreeContext(context_);
   JS_FreeRuntime(runtime_);
 }
@@ -109,7 +120,10 @@ std::unordered_map<std::string, int64_t> QuickJSRuntime::getHeapInfo() {
       {"array_count", memoryUsage.array_count},
       {"fast_array_count", memoryUsage.fast_array_count},
       {"fast_array_elements", memoryUsage.fast_array_elements},
-      {"binary_object_size", memoryUsage.binary_object_size}};
+      {"binary_object_size", memoryUsage.binary_object_size},
+      {"microtask_count", static_cast<int64_t>(microtaskCount_)},
+      {"microtask_time_us", microtaskDuration_.count()},
+      {"microtask_yield_count", static_cast<int64_t>(microtaskYieldCount_)}};
 }
 
 void QuickJSRuntime::checkAndThrowException(JSContext *context) const {
@@ -121,70 +135,235 @@ void QuickJSRuntime::checkAndThrowException(JSContext *context) const {
   }
 }
 
-std::string urlToCacheKey(const std::string &uri) {
-  std::regex dev_path_regex(R"(([a-zA-Z]+:\/\/)?([^\/\?]+)([^?\n]+)?)");
-  std::regex iOS_path_regex(R"([^\/]*$)");
-  std::smatch path_match;
+#if ENABLE_HASH_CHECK
+static constexpr uint32_t kCodeCacheFlags = CodeCacheHeader::kFullFingerprint;
+#else
+static constexpr uint32_t kCodeCacheFlags = 0;
+#endif
+
+static bool isDevServerUrl(const std::string &uri) {
+  return uri.find("http") != std::string::npos;
+}
+
+// A bundle served by the dev server is rebuilt under the same URL, often
+// with the same length, and a sampled fingerprint misses most edits. Its
+// whole source is hashed instead.
+static uint32_t codeCacheFlags(const std::string &url) {
+  return isDevServerUrl(url) ? kCodeCacheFlags | CodeCacheHeader::kFullFingerprint
+                             : kCodeCacheFlags;
+}
 
-  // Dev mode
-  if (uri.find("http") != std::string::npos && std::regex_search(uri, path_match, dev_path_regex)) {
-    return path_match[3];
+std::string urlToCacheKey(const std::string &uri) {
+  // Dev mode, keyed by the bundle path, e.g.
+  // http://localhost:8081/index.bundle?platform=ios -> /index.bundle
+  if (isDevServerUrl(uri)) {
+    size_t start = uri.find("://");
+    start = (start == std::string::npos) ? 0 : start + 3;
+    size_t pathStart = uri.find_first_of("/?", start);
+    if (pathStart == std::string::npos || uri[pathStart] == '?') {
+      return "codecache";
+    }
+    size_t pathEnd = uri.find_first_of("?\n", pathStart);
+    return uri.substr(
+        pathStart,
+        pathEnd == std::string::npos ? std::string::npos : pathEnd - pathStart);
   }
 
   // Release mode
 #ifdef __ANDROID__
   return uri;
 #elif defined(__APPLE__)
-  if (std::regex_search(uri, path_match, iOS_path_regex) && !path_match.empty()) {
-    return path_match[0];
-  }
+  size_t pos = uri.rfind('/');
+  return pos == std::string::npos ? uri : uri.substr(pos + 1);
+#else
   return "codecache";
 #endif
 }
 
+// Decompresses a compressed cache into anonymous memory, which is then read
+// in place like a mapped cache. The blocks are decompressed in file order
+// straight from the mapping, so the file is read once, sequentially.
+static std::unique_ptr<MappedFile> decompressCodeCache(const MappedFile &mappedFile) {
+  auto header = reinterpret_cast<const CodeCacheHeader *>(mappedFile.data());
+  const uint8_t *payload = mappedFile.data() + sizeof(CodeCacheHeader);
+#if ENABLE_HASH_CHECK
+  if (computePayloadChecksum(payload, header->payloadLength) != header->payloadChecksum) {
+    return nullptr;
+  }
+#endif
+  mappedFile.advise(0, mappedFile.size(), MADV_SEQUENTIAL);
+  auto decompressed = MappedFile::allocate(sizeof(CodeCacheHeader) + header->rawPayloadLength);
+  if (!decompressed ||
+      !decompressBlocks(payload,
+                        header->payloadLength,
+                        decompressed->data() + sizeof(CodeCacheHeader),
+                        header->rawPayloadLength)) {
+    return nullptr;
+  }
+
+  // The copied header describes the decompressed payload.
+  CodeCacheHeader rawHeader = *header;
+  rawHeader.flags &= ~CodeCacheHeader::kCompressed;
+  rawHeader.payloadLength = header->rawPayloadLength;
+  rawHeader.rawPayloadLength = 0;
+  memcpy(decompressed->data(), &rawHeader, sizeof(rawHeader));
+  return decompressed;
+}
+
 void QuickJSRuntime::loadCodeCache(CodeCacheItem &codeCacheItem, const std::string &url, const
     char *source, size_t size) {
   if (codeCacheDir_.empty()) {
     return;
   }
 
+  // A full fingerprint is computed on another thread while the cache is
+  // read, a sampled one is cheap enough to be computed when it is needed.
+  uint32_t flags = codeCacheFlags(url);
+  codeCacheItem.sourceFingerprint = std::async(
+      (flags & CodeCacheHeader::kFullFingerprint) ? std::launch::async
+                                                  : std::launch::deferred,
+      computeSourceFingerprint,
+      reinterpret_cast<const uint8_t *>(source),
+      size,
+      flags).share();
+
   std::string cacheKey = urlToCacheKey(url);
+  LOG(ERROR) << "read codecache " << url << " " << cacheKey;
+  auto mappedFile = codeCacheStore_->read(cacheKey);
+  if (!mappedFile) {
+    return;
+  }
+
+  auto header = reinterpret_cast<const CodeCacheHeader *>(mappedFile->data());
+  if (mappedFile->size() < sizeof(CodeCacheHeader) ||
+      !header->isValid(flags, mappedFile->size(), size)) {
+    LOG(ERROR) << "stale codecache " << cacheKey;
+    return;
+  }
+
+  bool compressed = header->flags & CodeCacheHeader::kCompressed;
+  if (compressed) {
+    // Also checks the payload checksum with ENABLE_HASH_CHECK.
+    mappedFile = decompressCodeCache(*mappedFile);
+    if (!mappedFile) {
+      LOG(ERROR) << "corrupted codecache " << cacheKey;
+      return;
+    }
+    header = reinterpret_cast<const CodeCacheHeader *>(mappedFile->data());
+  } else {
 #if ENABLE_HASH_CHECK
-  int hash = base::cityhash::CityHash32(source, size);
-  cacheKey = std::to_string(hash);
+    const uint8_t *payload = mappedFile->data() + sizeof(CodeCacheHeader);
+    uint32_t payloadLength = header->payloadLength;
+    uint32_t payloadChecksum = header->payloadChecksum;
+    codeCacheItem.payloadVerified = std::async(std::launch::async, [=]() {
+      return computePayloadChecksum(payload, payloadLength) == payloadChecksum;
+    });
 #endif
-
-  std::string codeCachePath = codeCacheDir_ + "/" + cacheKey;
-  std::vector<uint8_t> buffer;
-  LOG(ERROR) << "read codecache " << url << " " << codeCachePath;
-  if (folly::readFile(codeCachePath.c_str(), buffer)) {
-    auto *data = new uint8_t[buffer.size()];
-    memcpy(data, buffer.data(), buffer.size());
-    codeCacheItem.data = std::unique_ptr<uint8_t>(data);
-    codeCacheItem.size = buffer.size();
-    codeCacheItem.result = CodeCacheItem::INITIALIZED;
-    LOG(ERROR) << "read finish " << buffer.size();
   }
+  // A compressed cache is decompressed whole above, so its startup layout
+  // buys nothing and only uncompressed caches are read ahead selectively.
+  if (header->startupLength != 0 && !compressed) {
+    // Fault the atoms and the startup functions in ahead. The rest keeps
+    // the default readahead, as functions profiled as cold may still be
+    // needed at startup.
+    size_t startupEnd = sizeof(CodeCacheHeader) + header->startupLength;
+    mappedFile->advise(0, startupEnd, MADV_WILLNEED);
+  }
+  codeCacheItem.size = header->payloadLength;
+  codeCacheItem.startupSize = header->startupLength;
+  codeCacheItem.mappedFile = std::move(mappedFile);
+  codeCacheItem.result = CodeCacheItem::INITIALIZED;
+  LOG(ERROR) << "read finish " << codeCacheItem.size;
+}
+
+bool QuickJSRuntime::verifyCodeCache(CodeCacheItem &codeCacheItem) {
+  auto header = reinterpret_cast<const CodeCacheHeader *>(codeCacheItem.mappedFile->data());
+  bool valid = header->sourceFingerprint == codeCacheItem.sourceFingerprint.get();
+  if (codeCacheItem.payloadVerified.valid()) {
+    valid = codeCacheItem.payloadVerified.get() && valid;
+  }
+  return valid;
 }
 
-void QuickJSRuntime::updateCodeCache(CodeCacheItem &codeCacheItem, const std::string &url, const
-    char *source, size_t size) {
+void QuickJSRuntime::updateCodeCache(CodeCacheItem &codeCacheItem, const std::string &url,
+    size_t sourceLength) {
   if (codeCacheDir_.empty()) {
     return;
   }
 
+  // The payload checksum is filled in by the writer.
+  CodeCacheHeader header = CodeCacheHeader::create(
+      codeCacheFlags(url), codeCacheItem.size, codeCacheItem.startupSize, sourceLength,
+      codeCacheItem.sourceFingerprint.get());
+  memcpy(codeCacheItem.data.data(), &header, sizeof(header));
+
   std::string cacheKey = urlToCacheKey(url);
-#if ENABLE_HASH_CHECK
-  int hash = base::cityhash::CityHash32(source, size);
-  cacheKey = std::to_string(hash);
-#endif
+  LOG(ERROR) << "updatecode " << url << " " << cacheKey << " " << codeCacheItem.size;
+  // The entry is written off the JS thread, UPDATED is never observed here.
+  size_t prefetchSize = codeCacheItem.startupSize ?
+      sizeof(CodeCacheHeader) + codeCacheItem.startupSize : 0;
+  codeCacheStore_->write(cacheKey, std::move(codeCacheItem.data), prefetchSize);
+}
+
+bool QuickJSRuntime::serializeCodeCache(
+    CodeCacheItem &codeCacheItem, JSValueConst func, int flags) {
+  size_t size;
+  size_t startupSize = 0;
+  uint8_t *buf = JS_WriteObject3(
+      context_, &size, func, JS_WRITE_OBJ_BYTECODE | flags, nullptr, nullptr, &startupSize);
+  if (!buf || size == 0) {
+    js_free(context_, buf);
+    return false;
+  }
+
+  // Leave room for the header, filled in by updateCodeCache.
+  codeCacheItem.data.reserve(sizeof(CodeCacheHeader) + size);
+  codeCacheItem.data.resize(sizeof(CodeCacheHeader));
+  codeCacheItem.data.insert(codeCacheItem.data.end(), buf, buf + size);
+  js_free(context_, buf);
+  codeCacheItem.size = size;
+  codeCacheItem.startupSize = (flags & JS_WRITE_OBJ_STARTUP_LAYOUT) ? startupSize : 0;
+  codeCacheItem.result = CodeCacheItem::REQUEST_UPDATE;
+  return true;
+}
 
-  std::string codeCachePath = codeCacheDir_ + "/" + cacheKey;
-  std::vector<uint8_t> buffer(codeCacheItem.data.get(), codeCacheItem.data.get() + codeCacheItem
-      .size);
-  LOG(ERROR) << "updatecode " << url << " " << codeCachePath << " " << buffer.size();
-  if (folly::writeFile(buffer, codeCachePath.c_str())) {
-    codeCacheItem.result = CodeCacheItem::UPDATED;
+void QuickJSRuntime::setJSThreadScheduler(JSThreadScheduler scheduler) {
+  jsThreadScheduler_ = std::move(scheduler);
+}
+
+void QuickJSRuntime::scheduleCodeCacheFlush() {
+  if (!jsThreadScheduler_) {
+    return;
+  }
+  std::weak_ptr<bool> alive = alive_;
+  auto scheduler = jsThreadScheduler_;
+  auto postFlush = [=] {
+    scheduler([=] {
+      if (alive.lock()) {
+        flushPendingCodeCaches();
+      }
+    });
+  };
+  if (!CodeCacheWriter::getInstance().runWhenUndeferred(postFlush)) {
+    // Deferral ended in the meantime, still let the bundle run first.
+    postFlush();
+  }
+}
+
+void QuickJSRuntime::flushPendingCodeCaches() {
+  // The startup is over: everything it ran is marked, the rest is cold.
+  JS_SetStartupProfiling(runtime_, false);
+  std::vector<PendingCodeCache> pendingCodeCaches;
+  pendingCodeCaches.swap(pendingCodeCaches_);
+  for (auto &pending : pendingCodeCaches) {
+    CodeCacheItem codeCacheItem;
+    codeCacheItem.sourceFingerprint = pending.sourceFingerprint;
+    if (serializeCodeCache(codeCacheItem, pending.func, JS_WRITE_OBJ_STARTUP_LAYOUT)) {
+      updateCodeCache(codeCacheItem, pending.url, pending.sourceLength);
+    } else {
+      LOG(ERROR) << "no code cache " << pending.url;
+    }
+    JS_FreeValue(context_, pending.func);
   }
 }
 
@@ -204,92 +383,146 @@ double performanceNow() {
 jsi::Value QuickJSRuntime::evaluateJavaScript(
     const std::shared_ptr<const jsi::Buffer> &buffer,
     const std::string &sourceURL) {
+  if (!pendingCodeCaches_.empty() && !CodeCacheWriter::getInstance().isDeferred()) {
+    flushPendingCodeCaches();
+  }
+  if (isBytecodeBundle(buffer->data(), buffer->size())) {
+    return evaluateBytecodeBundle(buffer);
+  }
+
   bool enableCodeCache = true;
-  JSValue retValue;
-  ScopedJSValue scopedJsValue(context_, &retValue);
 
   if (enableCodeCache) {
     CodeCacheItem codeCacheItem;
     loadCodeCache(codeCacheItem, sourceURL, (const char *) buffer->data(), buffer->size());
     bool hasCodeCache = (codeCacheItem.result == CodeCacheItem::INITIALIZED);
-    JSValue func, cachedFunc;
+    JSValue func;
+    JSValue cachedFunc = JS_UNDEFINED;
+    ScopedJSValue scopedCachedFunc(context_, &cachedFunc);
     if (hasCodeCache) {
+      // Deserialize straight from the mapping: the bytecode is not copied,
+      // but the pages holding relocated atoms, which are most bytecode
+      // pages, get dirty. Nested functions stay in the mapping until they
+      // are first instantiated.
+      int flags = JS_READ_OBJ_BYTECODE | JS_READ_OBJ_ROM_DATA | JS_READ_OBJ_LAZY;
+#if !ENABLE_HASH_CHECK
+      // The payload is checksummed while it is read with ENABLE_HASH_CHECK,
+      // so it can't be relocated in place then.
+      flags |= JS_READ_OBJ_IN_PLACE;
+#endif
       func = JS_ReadObject(
           context_,
-          codeCacheItem.data.get(),
+          codeCacheItem.mappedFile->data() + sizeof(CodeCacheHeader),
           codeCacheItem.size,
-          JS_READ_OBJ_BYTECODE);
-    } else {
+          flags);
+      bool valid = !JS_IsException(func);
+      if (!valid) {
+        JS_FreeValue(context_, JS_GetException(context_));
+      }
+      if (!verifyCodeCache(codeCacheItem)) {
+        JS_FreeValue(context_, func);
+        valid = false;
+      }
+      if (valid) {
+        mappedCodeCaches_.push_back(std::move(codeCacheItem.mappedFile));
+      } else {
+        // Written for another source or corrupted, compile from source and
+        // overwrite it.
+        LOG(ERROR) << "invalid codecache " << sourceURL;
+        codeCacheItem.mappedFile = nullptr;
+        hasCodeCache = false;
+      }
+    }
+    if (!hasCodeCache) {
       func = JS_Eval(
           context_,
           (const char *) buffer->data(),
           buffer->size(),
           sourceURL.c_str(),
           JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+      checkAndThrowException(context_);
       cachedFunc = JS_DupValue(context_, func);
     }
-    checkAndThrowException(context_);
 
-    JSValue retValue = JS_EvalFunction(context_, func);
-    ScopedJSValue scopedResult(context_, &retValue);
+    // While cache writes are deferred the app is starting up: record which
+    // functions run and write the cache once the startup is over, laid out
+    // in the order it reads them.
+    bool profileStartup = !hasCodeCache && codeCacheStore_ &&
+        CodeCacheWriter::getInstance().isDeferred();
+    if (profileStartup) {
+      JS_SetStartupProfiling(runtime_, true);
+    }
 
-    checkAndThrowException(context_);
+    jsi::Value result = evaluateFunction(func);
 
-    for (;;) {
-      JSContext *ctx1;
-      int ret = JS_ExecutePendingJob(JS_GetRuntime(context_), &ctx1);
-      if (ret < 0) {
-        checkAndThrowException(context_);
-      } else if (ret == 0) {
-        break;
+    if (profileStartup) {
+      pendingCodeCaches_.push_back(
+          {sourceURL, cachedFunc, buffer->size(), codeCacheItem.sourceFingerprint});
+      cachedFunc = JS_UNDEFINED;
+      if (pendingCodeCaches_.size() == 1) {
+        scheduleCodeCacheFlush();
       }
-    }
-
-    if (!hasCodeCache) {
-      size_t size;
-      uint8_t *buf =
-          JS_WriteObject(context_, &size, cachedFunc, JS_WRITE_OBJ_BYTECODE);
-      ScopedJSValue scopedCachedFunc(context_, &cachedFunc);
-      if (buf && size != 0) {
-        codeCacheItem.data = std::unique_ptr<uint8_t>(buf);
-        codeCacheItem.size = size;
-        codeCacheItem.result = CodeCacheItem::REQUEST_UPDATE;
-        updateCodeCache(codeCacheItem, sourceURL, (const char *) buffer->data(), buffer->size());
-      } else {
+    } else if (!hasCodeCache) {
+      if (!serializeCodeCache(codeCacheItem, cachedFunc, 0)) {
         throw std::logic_error("no code cache");
       }
+      updateCodeCache(codeCacheItem, sourceURL, buffer->size());
     }
-  } else {
-    retValue = JS_Eval(
-        context_,
-        (const char *) buffer->data(),
-        buffer->size(),
-        sourceURL.c_str(),
-        JS_EVAL_TYPE_GLOBAL);
-
-    checkAndThrowException(context_);
-    for (;;) {
-      JSContext *ctx1;
-      int ret = JS_ExecutePendingJob(JS_GetRuntime(context_), &ctx1);
-      if (ret < 0) {
-        checkAndThrowException(context_);
-      } else if (ret == 0) {
-        break;
-      }
-    }
+    return result;
   }
+
+  JSValue func = JS_Eval(
+      context_,
+      (const char *) buffer->data(),
+      buffer->size(),
+      sourceURL.c_str(),
+      JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+  checkAndThrowException(context_);
+  return evaluateFunction(func);
+}
+
+jsi::Value QuickJSRuntime::evaluateBytecodeBundle(
+    const std::shared_ptr<const jsi::Buffer> &buffer) {
+  // The bundle buffer may be a read-only mapping, so atoms can't be
+  // relocated in place. The bytecode is still only copied when the atoms
+  // differ, and nested functions are read on first use, so the buffer is
+  // kept alive with the runtime.
+  JSValue func = JS_ReadObject(
+      context_,
+      buffer->data() + kBytecodeBundleHeaderSize,
+      buffer->size() - kBytecodeBundleHeaderSize,
+      JS_READ_OBJ_BYTECODE | JS_READ_OBJ_ROM_DATA | JS_READ_OBJ_LAZY);
+  checkAndThrowException(context_);
+  bytecodeBundles_.push_back(buffer);
+  return evaluateFunction(func);
+}
+
+jsi::Value QuickJSRuntime::evaluateFunction(JSValue func) {
+  JSValue retValue = JS_EvalFunction(context_, func);
+  ScopedJSValue scopedResult(context_, &retValue);
+  checkAndThrowException(context_);
+
+  runMicrotasks(-1);
   return JSIValueConverter::ToJSIValue(*this, retValue);
 }
 
 std::shared_ptr<const jsi::PreparedJavaScript> QuickJSRuntime::prepareJavaScript(
     const std::shared_ptr<const jsi::Buffer> &buffer,
     std::string sourceURL) {
+  // Only compiles in a scratch runtime, the host may prepare on any thread.
+  auto prepared = QuickJSPreparedJavaScript::compile(buffer, sourceURL);
+  if (prepared) {
+    return prepared;
+  }
   return std::make_shared<jsi::SourceJavaScriptPreparation>(
       buffer, std::move(sourceURL));
 }
 
 jsi::Value QuickJSRuntime::evaluatePreparedJavaScript(
     const std::shared_ptr<const jsi::PreparedJavaScript> &js) {
+  if (auto prepared = dynamic_cast<const QuickJSPreparedJavaScript *>(js.get())) {
+    return evaluateBytecodeBundle(prepared->bytecode());
+  }
   assert(
       dynamic_cast<const jsi::SourceJavaScriptPreparation *>(js.get()) &&
           "preparedJavaScript must be a SourceJavaScriptPreparation");
@@ -303,7 +536,7 @@ jsi::Object QuickJSRuntime::global() {
   JSValue global = JS_GetGlobalObject(context_);
   ScopedJSValue scopedJsValue(context_, &global);
   return make<jsi::Object>(
-      new QuickJSPointerValue(runtime_, context_, global));
+      QuickJSPointerValue::Create(runtime_, context_, global));
 }
 
 std::string QuickJSRuntime::description() {
@@ -333,7 +566,7 @@ jsi::Runtime::PointerValue *QuickJSRuntime::cloneSymbol(
   assert(JS_IsSymbol(jsValue));
   ScopedJSValue scopedJsValue(context_, &jsValue);
 
-  return new QuickJSPointerValue(runtime_, context_, jsValue);
+  return QuickJSPointerValue::Create(runtime_, context_, jsValue);
 }
 
 jsi::Runtime::PointerValue *QuickJSRuntime::cloneBigInt(
@@ -348,7 +581,7 @@ jsi::Runtime::PointerValue *QuickJSRuntime::cloneBigInt(
   assert(JS_IsBigInt(context_, jsValue));
   ScopedJSValue scopedJsValue(context_, &jsValue);
 
-  return new QuickJSPointerValue(runtime_, context_, jsValue);
+  return QuickJSPointerValue::Create(runtime_, context_, jsValue);
 }
 
 jsi::Runtime::PointerValue *QuickJSRuntime::cloneString(
@@ -364,7 +597,7 @@ jsi::Runtime::PointerValue *QuickJSRuntime::cloneString(
   assert(JS_IsString(jsValue));
   ScopedJSValue scopedJsValue(context_, &jsValue);
 
-  return new QuickJSPointerValue(runtime_, context_, jsValue);
+  return QuickJSPointerValue::Create(runtime_, context_, jsValue);
 }
 
 jsi::Runtime::PointerValue *QuickJSRuntime::cloneObject(
@@ -379,13 +612,19 @@ jsi::Runtime::PointerValue *QuickJSRuntime::cloneObject(
   assert(JS_IsObject(jsValue));
   ScopedJSValue scopedJsValue(context_, &jsValue);
 
-  return new QuickJSPointerValue(runtime_, context_, jsValue);
+  return QuickJSPointerValue::Create(runtime_, context_, jsValue);
 }
 
 jsi::Runtime::PointerValue *QuickJSRuntime::clonePropNameID(
     const Runtime::PointerValue *pv) {
   // TRACE_SCOPE("QuickJSRuntime", "string");
-  return cloneString(pv);
+  if (!pv) {
+    return nullptr;
+  }
+  const QuickJSAtomPointerValue *quickJSAtomPointerValue =
+      static_cast<const QuickJSAtomPointerValue *>(pv);
+  return QuickJSAtomPointerValue::Create(
+      runtime_, JS_DupAtom(context_, quickJSAtomPointerValue->Get()));
 }
 
 bool QuickJSRuntime::bigintIsInt64(const jsi::BigInt &bigInt) {
@@ -420,69 +659,97 @@ uint64_t QuickJSRuntime::truncate(const jsi::BigInt &bigInt) {
 }
 
 bool QuickJSRuntime::hasNativeState(const jsi::Object &object) {
-  JSValue jsValue = JSIValueConverter::ToJSObject(*this, object);
-  ScopedJSValue scopedJsValue(context_, &jsValue);
-  auto opaqueData = reinterpret_cast<OpaqueData *>(JS_GetOpaqueUnsafe(jsValue));
-  assert(opaqueData);
-  return opaqueData->nativeState_ != nullptr;
+  const QuickJSPointerValue *quickJSPointerValue =
+      static_cast<const QuickJSPointerValue *>(getPointerValue(object));
+  return JS_GetNativeState(quickJSPointerValue->value_) != nullptr;
 }
 
 std::shared_ptr<jsi::NativeState> QuickJSRuntime::getNativeState(const jsi::Object &object) {
-  JSValue jsValue = JSIValueConverter::ToJSObject(*this, object);
-  ScopedJSValue scopedJsValue(context_, &jsValue);
-  auto opaqueData = reinterpret_cast<OpaqueData *>(JS_GetOpaqueUnsafe(jsValue));
-  assert(opaqueData);
-  return opaqueData->nativeState_;
+  const QuickJSPointerValue *quickJSPointerValue =
+      static_cast<const QuickJSPointerValue *>(getPointerValue(object));
+  auto state = static_cast<std::shared_ptr<jsi::NativeState> *>(
+      JS_GetNativeState(quickJSPointerValue->value_));
+  return state ? *state : nullptr;
 }
 
+// Any object can hold a native state, it does not need to be a host object.
 void QuickJSRuntime::setNativeState(
     const jsi::Object &object,
     std::shared_ptr<jsi::NativeState> state) {
-  JSValue jsValue = JSIValueConverter::ToJSObject(*this, object);
-  ScopedJSValue scopedJsValue(context_, &jsValue);
-  auto opaqueData = reinterpret_cast<OpaqueData *>(JS_GetOpaqueUnsafe(jsValue));
-  assert(opaqueData);
-  opaqueData->nativeState_ = state;
+  const QuickJSPointerValue *quickJSPointerValue =
+      static_cast<const QuickJSPointerValue *>(getPointerValue(object));
+  auto *slot = state ? new std::shared_ptr<jsi::NativeState>(std::move(state)) : nullptr;
+  if (JS_SetNativeState(context_, quickJSPointerValue->value_, slot) < 0) {
+    delete slot;
+    checkAndThrowException(context_);
+  }
 }
 
 bool QuickJSRuntime::drainMicrotasks(int maxMicrotasksHint) {
-  int taskNum = 0;
-  int ret;
-  for (;;) {
-    if (taskNum < maxMicrotasksHint || maxMicrotasksHint == -1) {
-      JSContext *ctx1;
-      ret = JS_ExecutePendingJob(JS_GetRuntime(context_), &ctx1);
-      taskNum++;
-      if (ret < 0) {
-        checkAndThrowException(context_);
-      } else if (ret == 0) {
-        return true;
-      }
-    } else {
-      break;
-    }
+  return runMicrotasks(maxMicrotasksHint < 0 ? -1 : maxMicrotasksHint);
+}
+
+bool QuickJSRuntime::drainMicrotasks(
+    MicrotaskDrain &drain,
+    std::chrono::microseconds budget) {
+  // TRACE_SCOPE("QuickJSRuntime", "drainMicrotasks");
+  auto start = std::chrono::steady_clock::now();
+  auto deadline = start + budget;
+  uint64_t startCount = microtaskCount_;
+  auto update = [&] {
+    drain.jobCount += microtaskCount_ - startCount;
+    drain.duration += std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+  };
+
+  bool done;
+  try {
+    do {
+      done = runMicrotasks(kMicrotaskBatchSize);
+    } while (!done && std::chrono::steady_clock::now() < deadline);
+  } catch (...) {
+    update();
+    throw;
   }
-  return false;
+  update();
+  drain.done = done;
+  if (!done) {
+    drain.yieldCount++;
+    microtaskYieldCount_++;
+  }
+  return done;
+}
+
+bool QuickJSRuntime::runMicrotasks(int maxCount) {
+  auto start = std::chrono::steady_clock::now();
+  int count;
+  JSContext *jobContext;
+  int ret = JS_ExecutePendingJobs(runtime_, maxCount, &count, &jobContext);
+  microtaskCount_ += count;
+  microtaskDuration_ += std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  if (ret < 0) {
+    checkAndThrowException(jobContext);
+  }
+  return ret == 0;
 }
 
 jsi::PropNameID QuickJSRuntime::createPropNameIDFromAscii(
     const char *str,
     size_t length) {
   // TRACE_SCOPE("QuickJSRuntime", "string");
-  JSValue jsValue = JS_NewStringLen(context_, str, length);
-  ScopedJSValue scopedJsValue(context_, &jsValue);
-  QuickJSPointerValue *value = new QuickJSPointerValue(runtime_, context_, jsValue);
-  return make<jsi::PropNameID>(value);
+  return createPropNameIDFromUtf8(reinterpret_cast<const uint8_t *>(str), length);
 }
 
 jsi::PropNameID QuickJSRuntime::createPropNameIDFromUtf8(
     const uint8_t *utf8,
     size_t length) {
   // TRACE_SCOPE("QuickJSRuntime", "string");
-  JSValue jsValue = JS_NewStringLen(context_, (const char *) utf8, length);
-  ScopedJSValue scopedJsValue(context_, &jsValue);
-  QuickJSPointerValue *value = new QuickJSPointerValue(runtime_, context_, jsValue);
-  return make<jsi::PropNameID>(value);
+  JSAtom atom = JS_NewAtomLen(context_, (const char *) utf8, length);
+  if (atom == JS_ATOM_NULL) {
+    checkAndThrowException(context_);
+  }
+  return make<jsi::PropNameID>(QuickJSAtomPointerValue::Create(runtime_, atom));
 }
 
 jsi::PropNameID QuickJSRuntime::createPropNameIDFromString(const jsi::String &str) {
@@ -494,36 +761,22 @@ jsi::PropNameID QuickJSRuntime::createPropNameIDFromString(const jsi::String &st
 
   assert(JS_IsString(jsValue));
 
-  auto utf8 = JS_ToCString(context_, jsValue);
-  auto result = createPropNameIDFromUtf8(
-      reinterpret_cast<const uint8_t *>(utf8), strlen(utf8));
-  JS_FreeCString(context_, utf8);
-  return result;
+  JSAtom atom = JS_ValueToAtom(context_, jsValue);
+  if (atom == JS_ATOM_NULL) {
+    checkAndThrowException(context_);
+  }
+  return make<jsi::PropNameID>(QuickJSAtomPointerValue::Create(runtime_, atom));
 }
 
 std::string QuickJSRuntime::utf8(const jsi::PropNameID &sym) {
   // TRACE_SCOPE("QuickJSRuntime", "string");
-  const QuickJSPointerValue *quickJSPointerValue =
-      static_cast<const QuickJSPointerValue *>(getPointerValue(sym));
-  JSValue jsValue = quickJSPointerValue->Get(context_);
-  ScopedJSValue scopedJsValue(context_, &jsValue);
-  return JSIValueConverter::ToSTLString(context_, jsValue);
+  return JSIValueConverter::ToSTLString(context_, JSIValueConverter::ToJSAtom(*this, sym));
 }
 
 bool QuickJSRuntime::compare(const jsi::PropNameID &a, const jsi::PropNameID &b) {
   // TRACE_SCOPE("QuickJSRuntime", "misc");
-  const QuickJSPointerValue *quickJSPointValueA =
-      static_cast<const QuickJSPointerValue *>(getPointerValue(a));
-  JSValue jsValueA = quickJSPointValueA->Get(context_);
-  const QuickJSPointerValue *quickJSPointValueB =
-      static_cast<const QuickJSPointerValue *>(getPointerValue(b));
-  JSValue jsValueB = quickJSPointValueB->Get(context_);
-
-  ScopedJSValue scopedJsValueA(context_, &jsValueA);
-  ScopedJSValue scopedJsValueB(context_, &jsValueB);
-  auto result = JS_IsStrictEqual(context_, jsValueA, jsValueB);
-  checkAndThrowException(context_);
-  return result;
+  // Atoms are interned, equal names are the same atom.
+  return JSIValueConverter::ToJSAtom(*this, a) == JSIValueConverter::ToJSAtom(*this, b);
 }
 
 std::string QuickJSRuntime::symbolToString(const jsi::Symbol &symbol) {
@@ -535,7 +788,7 @@ jsi::String QuickJSRuntime::createStringFromAscii(const char *str, size_t length
   // TRACE_SCOPE("QuickJSRuntime", "string");
   JSValue jsValue = JS_NewStringLen(context_, str, length);
   ScopedJSValue scopedJsValue(context_, &jsValue);
-  QuickJSPointerValue *value = new QuickJSPointerValue(runtime_, context_, jsValue);
+  QuickJSPointerValue *value = QuickJSPointerValue::Create(runtime_, context_, jsValue);
   return make<jsi::String>(value);
 }
 
@@ -543,10 +796,25 @@ jsi::String QuickJSRuntime::createStringFromUtf8(const uint8_t *str, size_t leng
   // TRACE_SCOPE("QuickJSRuntime", "string");
   JSValue jsValue = JS_NewStringLen(context_, (const char *) str, length);
   ScopedJSValue scopedJsValue(context_, &jsValue);
-  QuickJSPointerValue *value = new QuickJSPointerValue(runtime_, context_, jsValue);
+  QuickJSPointerValue *value = QuickJSPointerValue::Create(runtime_, context_, jsValue);
   return make<jsi::String>(value);
 }
 
+jsi::Value QuickJSRuntime::createValueFromJsonUtf8(const uint8_t *json, size_t length) {
+  // TRACE_SCOPE("QuickJSRuntime", "json");
+  // The parser needs a terminating zero, which |json| does not guarantee.
+  // Copying is still far cheaper than the default implementation, which
+  // creates a string and looks up JSON.parse.
+  std::unique_ptr<char[]> buffer(new char[length + 1]);
+  memcpy(buffer.get(), json, length);
+  buffer[length] = '\0';
+
+  JSValue jsValue = JS_ParseJSON(context_, buffer.get(), length, "<input>");
+  ScopedJSValue scopedJsValue(context_, &jsValue);
+  checkAndThrowException(context_);
+  return JSIValueConverter::ToJSIValue(*this, jsValue);
+}
+
 std::string QuickJSRuntime::utf8(const jsi::String &str) {
   // TRACE_SCOPE("QuickJSRuntime", "string");
   const QuickJSPointerValue *quickJSPointerValue =
@@ -562,7 +830,7 @@ jsi::Object QuickJSRuntime::createObject() {
   // TRACE_SCOPE("QuickJSRuntime", "object");
   JSValue jsValue = JS_NewObject(context_);
   ScopedJSValue scopedJsValue(context_, &jsValue);
-  return make<jsi::Object>(new QuickJSPointerValue(runtime_, context_, jsValue));
+  return make<jsi::Object>(QuickJSPointerValue::Create(runtime_, context_, jsValue));
 }
 
 jsi::Object QuickJSRuntime::createObject(
@@ -601,7 +869,7 @@ jsi::Object QuickJSRuntime::createObject(
 
   JS_SetOpaque(object, hostObjectProxy->GetOpaqueData());
 
-  return make<jsi::Object>(new QuickJSPointerValue(runtime_, context_, object));
+  return make<jsi::Object>(QuickJSPointerValue::Create(runtime_, context_, object));
 }
 
 std::shared_ptr<jsi::HostObject> QuickJSRuntime::getHostObject(
@@ -620,6 +888,36 @@ std::shared_ptr<jsi::HostObject> QuickJSRuntime::getHostObject(
   return hostObjectProxy->GetHostObject();
 }
 
+void QuickJSRuntime::setHostObjectMemoized(const jsi::Object &object, bool memoized) {
+  assert(isHostObject(object));
+  JSValue jsValue = JSIValueConverter::ToJSObject(*this, object);
+  ScopedJSValue scopedJsValue(context_, &jsValue);
+  auto opaqueData = reinterpret_cast<OpaqueData *>(JS_GetOpaque(jsValue,
+                                                                HostObjectProxy::GetClassID()));
+  assert(opaqueData);
+  reinterpret_cast<HostObjectProxy *>(opaqueData->hostData_)->SetMemoizeAll(memoized);
+  if (!memoized) {
+    invalidateHostObjectProperties(object);
+  }
+}
+
+void QuickJSRuntime::invalidateHostObjectProperty(
+    const jsi::Object &object,
+    const jsi::PropNameID &name) {
+  assert(isHostObject(object));
+  const QuickJSPointerValue *quickJSPointerValue =
+      static_cast<const QuickJSPointerValue *>(getPointerValue(object));
+  JS_DeleteMemoizedProperty(context_, quickJSPointerValue->value_,
+                            JSIValueConverter::ToJSAtom(*this, name));
+}
+
+void QuickJSRuntime::invalidateHostObjectProperties(const jsi::Object &object) {
+  assert(isHostObject(object));
+  const QuickJSPointerValue *quickJSPointerValue =
+      static_cast<const QuickJSPointerValue *>(getPointerValue(object));
+  JS_ClearMemoizedProperties(context_, quickJSPointerValue->value_);
+}
+
 jsi::HostFunctionType &QuickJSRuntime::getHostFunction(
     const jsi::Function &function) {
   assert(isHostFunction(function));
@@ -643,8 +941,7 @@ jsi::Value QuickJSRuntime::getProperty(
     const jsi::PropNameID &name) {
   // TRACE_SCOPE("QuickJSRuntime", "object");
   auto jsValue = JSIValueConverter::ToJSObject(*this, object);
-  auto jsName = name.utf8(*this);
-  auto prop = JS_GetPropertyStr(context_, jsValue, jsName.c_str());
+  auto prop = JS_GetProperty(context_, jsValue, JSIValueConverter::ToJSAtom(*this, name));
   ScopedJSValue scopeValue(context_, &jsValue);
   ScopedJSValue scopeProp(context_, &prop);
 
@@ -658,9 +955,11 @@ jsi::Value QuickJSRuntime::getProperty(
     const jsi::String &name) {
   // TRACE_SCOPE("QuickJSRuntime", "object");
   auto jsValue = JSIValueConverter::ToJSObject(*this, object);
-  auto jsName = name.utf8(*this);
-  auto prop = JS_GetPropertyStr(context_, jsValue, jsName.c_str());
   ScopedJSValue scopeValue(context_, &jsValue);
+  auto jsName = JSIValueConverter::ToJSString(*this, name);
+  ScopedJSValue scopeName(context_, &jsName);
+  ScopedJSAtom scopedAtom(context_, JS_ValueToAtom(context_, jsName));
+  auto prop = JS_GetProperty(context_, jsValue, scopedAtom.get());
   ScopedJSValue scopeProp(context_, &prop);
 
   checkAndThrowException(context_);
@@ -674,9 +973,11 @@ bool QuickJSRuntime::hasProperty(
   // TRACE_SCOPE("QuickJSRuntime", "object");
   auto jsValue = JSIValueConverter::ToJSObject(*this, object);
   ScopedJSValue scopeValue(context_, &jsValue);
-  auto jsName = JS_NewAtom(context_, name.utf8(*this).c_str());
-
-  return JS_HasProperty(context_, jsValue, jsName) == TRUE;
+  int result = JS_HasProperty(context_, jsValue, JSIValueConverter::ToJSAtom(*this, name));
+  if (result < 0) {
+    checkAndThrowException(context_);
+  }
+  return result == TRUE;
 }
 
 bool QuickJSRuntime::hasProperty(
@@ -685,9 +986,14 @@ bool QuickJSRuntime::hasProperty(
   // TRACE_SCOPE("QuickJSRuntime", "object");
   auto jsValue = JSIValueConverter::ToJSObject(*this, object);
   ScopedJSValue scopeValue(context_, &jsValue);
-  auto jsName = JS_NewAtom(context_, name.utf8(*this).c_str());
-
-  return JS_HasProperty(context_, jsValue, jsName) == TRUE;
+  auto jsName = JSIValueConverter::ToJSString(*this, name);
+  ScopedJSValue scopeName(context_, &jsName);
+  ScopedJSAtom scopedAtom(context_, JS_ValueToAtom(context_, jsName));
+  int result = JS_HasProperty(context_, jsValue, scopedAtom.get());
+  if (result < 0) {
+    checkAndThrowException(context_);
+  }
+  return result == TRUE;
 }
 
 void QuickJSRuntime::setPropertyValue(
@@ -697,12 +1003,12 @@ void QuickJSRuntime::setPropertyValue(
   // TRACE_SCOPE("QuickJSRuntime", "object");
   auto jsValue = JSIValueConverter::ToJSObject(*this, object);
   auto jsProperty = JSIValueConverter::ToJSValue(*this, value);
-  auto jsName = name.utf8(*this);
   ScopedJSValue scopeValue(context_, &jsValue);
 
   // DO NOT FREE jsProperty
-  JS_SetPropertyStr(context_, jsValue, jsName.c_str(), jsProperty);
-  checkAndThrowException(context_);
+  if (JS_SetProperty(context_, jsValue, JSIValueConverter::ToJSAtom(*this, name), jsProperty) < 0) {
+    checkAndThrowException(context_);
+  }
 }
 
 void QuickJSRuntime::setPropertyValue(
@@ -712,12 +1018,15 @@ void QuickJSRuntime::setPropertyValue(
   // TRACE_SCOPE("QuickJSRuntime", "object");
   auto jsValue = JSIValueConverter::ToJSObject(*this, object);
   auto jsProperty = JSIValueConverter::ToJSValue(*this, value);
-  auto jsName = name.utf8(*this);
   ScopedJSValue scopeValue(context_, &jsValue);
+  auto jsName = JSIValueConverter::ToJSString(*this, name);
+  ScopedJSValue scopeName(context_, &jsName);
+  ScopedJSAtom scopedAtom(context_, JS_ValueToAtom(context_, jsName));
 
   // DO NOT FREE jsProperty
-  JS_SetPropertyStr(context_, jsValue, jsName.c_str(), jsProperty);
-  checkAndThrowException(context_);
+  if (JS_SetProperty(context_, jsValue, scopedAtom.get(), jsProperty) < 0) {
+    checkAndThrowException(context_);
+  }
 }
 
 bool QuickJSRuntime::isArray(const jsi::Object &object) const {
@@ -774,18 +1083,18 @@ jsi::Array QuickJSRuntime::getPropertyNames(const jsi::Object &object) {
                                    JS_GPN_ENUM_ONLY | JS_GPN_STRING_MASK);
   checkAndThrowException(context_);
 
-  auto result = JS_NewArray(context_);
-  ScopedJSValue scopeResult(context_, &result);
-  for (int i = 0; i < size; i++) {
-    JSValue prop = JS_AtomToValue(context_, names[i].atom);
-    // DO NOT FREE prop
-    JS_SetPropertyUint32(context_, result, i, prop);
-    checkAndThrowException(context_);
+  std::vector<JSValue> elements(size);
+  for (uint32_t i = 0; i < size; i++) {
+    elements[i] = JS_AtomToValue(context_, names[i].atom);
   }
-
   JS_FreeEnumArray(context_, names, size);
 
-  return make<jsi::Object>(new QuickJSPointerValue(runtime_, context_, result)).getArray(*this);
+  // Takes over the elements.
+  auto result = JS_NewArrayFrom(context_, size, elements.data());
+  ScopedJSValue scopeResult(context_, &result);
+  checkAndThrowException(context_);
+
+  return make<jsi::Object>(QuickJSPointerValue::Create(runtime_, context_, result)).getArray(*this);
 }
 
 jsi::WeakObject QuickJSRuntime::createWeakObject(const jsi::Object &weakObject) {
@@ -794,7 +1103,7 @@ jsi::WeakObject QuickJSRuntime::createWeakObject(const jsi::Object &weakObject)
   JSValue value = pointer->Get(context_);
   ScopedJSValue scopedJsValue(context_, &value);
 
-  return make<jsi::WeakObject>(new QuickJSPointerValue(runtime_, context_, value));
+  return make<jsi::WeakObject>(QuickJSPointerValue::Create(runtime_, context_, value));
 }
 
 jsi::Value QuickJSRuntime::lockWeakObject(jsi::WeakObject &weakObject) {
@@ -812,10 +1121,26 @@ jsi::Value QuickJSRuntime::lockWeakObject(jsi::WeakObject &weakObject) {
 
 jsi::Array QuickJSRuntime::createArray(size_t length) {
   // TRACE_SCOPE("QuickJSRuntime", "array");
-  auto result = JS_NewArray(context_);
+  // Preallocated unless large, filling it in order does not reallocate.
+  auto result = JS_NewArrayLength(context_, static_cast<uint32_t>(length));
+  ScopedJSValue scopeResult(context_, &result);
+  checkAndThrowException(context_);
+
+  return make<jsi::Object>(QuickJSPointerValue::Create(runtime_, context_, result)).getArray(*this);
+}
+
+jsi::Array QuickJSRuntime::createArray(const jsi::Value *elements, size_t count) {
+  // TRACE_SCOPE("QuickJSRuntime", "array");
+  std::vector<JSValue> values(count);
+  for (size_t i = 0; i < count; i++) {
+    values[i] = JSIValueConverter::ToJSValue(*this, elements[i]);
+  }
+  // Takes over the values.
+  auto result = JS_NewArrayFrom(context_, static_cast<uint32_t>(count), values.data());
   ScopedJSValue scopeResult(context_, &result);
+  checkAndThrowException(context_);
 
-  return make<jsi::Object>(new QuickJSPointerValue(runtime_, context_, result)).getArray(*this);
+  return make<jsi::Object>(QuickJSPointerValue::Create(runtime_, context_, result)).getArray(*this);
 }
 
 size_t QuickJSRuntime::size(const jsi::Array &array) {
@@ -831,11 +1156,27 @@ size_t QuickJSRuntime::size(const jsi::Array &array) {
 }
 
 size_t QuickJSRuntime::size(const jsi::ArrayBuffer &arrayBuffer) {
-  throw std::logic_error("Not implemented");
+  // TRACE_SCOPE("QuickJSRuntime", "array");
+  size_t size = 0;
+  data(arrayBuffer, &size);
+  return size;
 }
 
 uint8_t *QuickJSRuntime::data(const jsi::ArrayBuffer &arrayBuffer) {
-  throw std::logic_error("Not implemented");
+  // TRACE_SCOPE("QuickJSRuntime", "array");
+  size_t size;
+  return data(arrayBuffer, &size);
+}
+
+uint8_t *QuickJSRuntime::data(const jsi::ArrayBuffer &arrayBuffer, size_t *size) {
+  auto jsValue = JSIValueConverter::ToJSObject(*this, arrayBuffer);
+  ScopedJSValue scopeValue(context_, &jsValue);
+  // The backing store itself, no copy. Throws if the buffer was detached.
+  uint8_t *data = JS_GetArrayBuffer(context_, size, jsValue);
+  if (!data) {
+    checkAndThrowException(context_);
+  }
+  return data;
 }
 
 jsi::Value QuickJSRuntime::getValueAtIndex(const jsi::Array &array, size_t i) {
@@ -843,6 +1184,12 @@ jsi::Value QuickJSRuntime::getValueAtIndex(const jsi::Array &array, size_t i) {
   auto jsValue = JSIValueConverter::ToJSArray(*this, array);
   ScopedJSValue scopeValue(context_, &jsValue);
 
+  JSValue *elements;
+  uint32_t count;
+  if (JS_GetFastArray(context_, jsValue, &elements, &count) && i < count) {
+    return JSIValueConverter::ToJSIValue(*this, elements[i]);
+  }
+
   JSValue property = JS_GetPropertyUint32(context_, jsValue, i);
   ScopedJSValue scopeProperty(context_, &property);
 
@@ -859,12 +1206,32 @@ void QuickJSRuntime::setValueAtIndexImpl(
   ScopedJSValue scopeValue(context_, &jsValue);
 
   auto property = JSIValueConverter::ToJSValue(*this, value);
+
+  // Elements of fast arrays are plain writable data properties.
+  JSValue *elements;
+  uint32_t count;
+  if (JS_GetFastArray(context_, jsValue, &elements, &count) && i < count) {
+    JSValue previous = elements[i];
+    elements[i] = property;
+    JS_FreeValue(context_, previous);
+    return;
+  }
+
   // DO NOT FREE property
   if (JS_SetPropertyUint32(context_, jsValue, i, property) != TRUE) {
     checkAndThrowException(context_);
   }
 }
 
+// Gives a host function the name and length properties of a JS function.
+static void defineFunctionNameAndLength(
+    JSContext *ctx, JSValueConst func, JSAtom name, unsigned int paramCount) {
+  JS_DefinePropertyValueStr(ctx, func, "length", JS_NewUint32(ctx, paramCount),
+                            JS_PROP_CONFIGURABLE);
+  JS_DefinePropertyValueStr(ctx, func, "name", JS_AtomToString(ctx, name),
+                            JS_PROP_CONFIGURABLE);
+}
+
 jsi::Function QuickJSRuntime::createFunctionFromHostFunction(
     const jsi::PropNameID &name,
     unsigned int paramCount,
@@ -901,39 +1268,108 @@ jsi::Function QuickJSRuntime::createFunctionFromHostFunction(
   ScopedJSValue scopedJsProto(context_, &proto);
 
   JS_SetOpaque(object, hostFunctionProxy->GetOpaqueData());
+  defineFunctionNameAndLength(
+      context_, object, JSIValueConverter::ToJSAtom(*this, name), paramCount);
+
+  return make<jsi::Object>(QuickJSPointerValue::Create(runtime_, context_, object))
+      .getFunction(*this);
+}
+
+jsi::Function QuickJSRuntime::createFastHostFunction(
+    const jsi::PropNameID &name,
+    unsigned int paramCount,
+    FastHostFunctionProxy *proxy) {
+  // TRACE_SCOPE("QuickJSRuntime", "object");
+  JSClassID jsClassID = FastHostFunctionProxy::GetClassID();
+
+  JSValue proto = JS_GetClassProtoOrNull(context_, jsClassID);
+  if (JS_IsNull(proto)) {
+    proto = JS_NewObject(context_);
+    JS_NewClass(
+        JS_GetRuntime(context_), jsClassID, &FastHostFunctionProxy::kJSClassDef);
+    JS_SetClassProto(context_, jsClassID, proto);
+    JS_DupValue(context_, proto);
+  }
+
+  JSValue object =
+      JS_NewObjectProtoClass(context_, proto, jsClassID);
+  ScopedJSValue scopedJsValue(context_, &object);
+  ScopedJSValue scopedJsProto(context_, &proto);
 
-  return make<jsi::Object>(new QuickJSPointerValue(runtime_, context_, object))
+  JS_SetOpaque(object, proxy->GetOpaqueData());
+  defineFunctionNameAndLength(
+      context_, object, JSIValueConverter::ToJSAtom(*this, name), paramCount);
+
+  return make<jsi::Object>(QuickJSPointerValue::Create(runtime_, context_, object))
       .getFunction(*this);
 }
 
+namespace {
+
+// Arguments of a call into JS, converted on the stack for the usual arities.
+class JSArguments {
+ public:
+  JSArguments(const QuickJSRuntime &runtime, const jsi::Value *args, size_t count)
+      : context_(runtime.getJSContext()), count_(count) {
+    if (count_ > kMaxStackArgCount) {
+      heapArgs_.reset(new JSValue[count_]);
+      argv_ = heapArgs_.get();
+    } else {
+      argv_ = stackArgs_;
+    }
+    for (size_t i = 0; i < count_; i++) {
+      argv_[i] = JSIValueConverter::ToJSValue(runtime, args[i]);
+    }
+  }
+
+  ~JSArguments() {
+    for (size_t i = 0; i < count_; i++) {
+      JS_FreeValue(context_, argv_[i]);
+    }
+  }
+
+  // Prevent copying of the arguments.
+  JSArguments(const JSArguments &) = delete;
+  JSArguments &operator=(const JSArguments &) = delete;
+
+  JSValue *argv() const {
+    return argv_;
+  };
+
+ private:
+  static constexpr size_t kMaxStackArgCount = 8;
+
+  JSContext *context_;
+  size_t count_;
+  JSValue *argv_;
+  JSValue stackArgs_[kMaxStackArgCount];
+  std::unique_ptr<JSValue[]> heapArgs_;
+};
+
+} // namespace
+
 jsi::Value QuickJSRuntime::call(
     const jsi::Function &function,
     const jsi::Value &jsThis,
     const jsi::Value *args,
     size_t count) {
-
   auto jsFunction = JSIValueConverter::ToJSFunction(*this, function);
   ScopedJSValue scopedJsFunction(context_, &jsFunction);
 
-  auto jsObject = jsThis.isUndefined() ? JS_GetGlobalObject(context_) :
-      JSIValueConverter::ToJSValue(*this, jsThis);
+  // An undefined this is passed as is: sloppy functions bind it to the
+  // global object themselves, strict ones must see undefined.
+  auto jsObject = JSIValueConverter::ToJSValue(*this, jsThis);
   ScopedJSValue scopedJsObject(context_, &jsObject);
 
-  JSValue *argv = new JSValue[count];
-  for (size_t i = 0; i < count; i++) {
-    argv[i] = JSIValueConverter::ToJSValue(*this, args[i]);
-  }
-
+  JSArguments arguments(*this, args, count);
   auto result = JS_Call(context_, jsFunction, jsObject,
-                        count, argv);
+                        count, arguments.argv());
   ScopedJSValue scopeResult(context_, &result);
 
-  for (size_t i = 0; i < count; i++) {
-    JS_FreeValue(context_, argv[i]);
+  if (JS_IsException(result)) {
+    checkAndThrowException(context_);
   }
 
-  checkAndThrowException(context_);
-
   return JSIValueConverter::ToJSIValue(*this, result);
 }
 
@@ -945,20 +1381,14 @@ jsi::Value QuickJSRuntime::callAsConstructor(
   auto jsFunction = JSIValueConverter::ToJSFunction(*this, function);
   ScopedJSValue scopedJsFunction(context_, &jsFunction);
 
-  JSValue *argv = new JSValue[count];
-  for (size_t i = 0; i < count; i++) {
-    argv[i] = JSIValueConverter::ToJSValue(*this, args[i]);
-  }
-
-  auto result = JS_CallConstructor(context_, jsFunction, count, argv);
+  JSArguments arguments(*this, args, count);
+  auto result = JS_CallConstructor(context_, jsFunction, count, arguments.argv());
   ScopedJSValue scopeResult(context_, &result);
 
-  for (size_t i = 0; i < count; i++) {
-    JS_FreeValue(context_, argv[i]);
+  if (JS_IsException(result)) {
+    checkAndThrowException(context_);
   }
 
-  checkAndThrowException(context_);
-
   return JSIValueConverter::ToJSIValue(*this, result);
 }
 
@@ -1019,13 +1449,41 @@ bool QuickJSRuntime::instanceOf(const jsi::Object &o, const jsi::Function &f) {
 }
 
 jsi::PropNameID QuickJSRuntime::createPropNameIDFromSymbol(const jsi::Symbol &sym) {
-  auto str = sym.toString(*this);
-  return createPropNameIDFromAscii(str.c_str(), str.length());
+  // The atom of a symbol is the symbol itself, not its description.
+  JSValue jsValue = JSIValueConverter::ToJSSymbol(*this, sym);
+  ScopedJSValue scopedJsValue(context_, &jsValue);
+  JSAtom atom = JS_ValueToAtom(context_, jsValue);
+  if (atom == JS_ATOM_NULL) {
+    checkAndThrowException(context_);
+  }
+  return make<jsi::PropNameID>(QuickJSAtomPointerValue::Create(runtime_, atom));
 }
 
 jsi::ArrayBuffer QuickJSRuntime::createArrayBuffer(
     std::shared_ptr<jsi::MutableBuffer> buffer) {
-  throw std::logic_error("Not implemented");
+  // TRACE_SCOPE("QuickJSRuntime", "array");
+  // The ArrayBuffer uses the memory of |buffer| and keeps it alive until it
+  // is collected.
+  uint8_t *data = buffer->data();
+  size_t size = buffer->size();
+  auto opaque = new std::shared_ptr<jsi::MutableBuffer>(std::move(buffer));
+  JSValue jsValue = JS_NewArrayBuffer(
+      context_,
+      data,
+      size,
+      [](JSRuntime *rt, void *opaque, void *ptr) {
+        delete static_cast<std::shared_ptr<jsi::MutableBuffer> *>(opaque);
+      },
+      opaque,
+      FALSE);
+  if (JS_IsException(jsValue)) {
+    // The free callback is only called once the ArrayBuffer exists.
+    delete opaque;
+    checkAndThrowException(context_);
+  }
+  ScopedJSValue scopedJsValue(context_, &jsValue);
+  return make<jsi::Object>(QuickJSPointerValue::Create(runtime_, context_, jsValue))
+      .getArrayBuffer(*this);
 }
 
 bool QuickJSRuntime::strictEquals(const jsi::BigInt &a, const jsi::BigInt &b) const {
@@ -1043,12 +1501,12 @@ bool QuickJSRuntime::strictEquals(const jsi::BigInt &a, const jsi::BigInt &b) co
 
 jsi::BigInt QuickJSRuntime::createBigIntFromInt64(int64_t v) {
   return make<jsi::BigInt>(
-      new QuickJSPointerValue(runtime_, context_, JS_NewBigInt64(context_, v)));
+      QuickJSPointerValue::Create(runtime_, context_, JS_NewBigInt64(context_, v)));
 }
 
 jsi::BigInt QuickJSRuntime::createBigIntFromUint64(uint64_t v) {
   return make<jsi::BigInt>(
-      new QuickJSPointerValue(runtime_, context_, JS_NewBigUint64(context_, v)));
+      QuickJSPointerValue::Create(runtime_, context_, JS_NewBigUint64(context_, v)));
 }
 
 jsi::String QuickJSRuntime::bigintToString(const jsi::BigInt &value, int radix) {
@@ -1067,6 +1525,6 @@ jsi::String QuickJSRuntime::bigintToString(const jsi::BigInt &value, int radix)
   assert(JS_IsString(ret));
 
   return make<jsi::String>(
-      new QuickJSPointerValue(runtime_, context_, ret));
+      QuickJSPointerValue::Create(runtime_, context_, ret));
 }
 } // namespace qjs
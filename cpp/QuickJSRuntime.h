@@ -1,18 +1,28 @@
 #pragma once
 
+#include <chrono>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include "jsi/jsi.h"
 #include "quickjs.h"
+#include "MappedFile.h"
+#include "PointerValuePool.h"
 
 namespace jsi = facebook::jsi;
 
 namespace qjs {
 
+class CodeCacheStore;
 class QuickJSInstrumentation;
 class QuickJSPointerValue;
+class QuickJSAtomPointerValue;
+class FastHostFunctionProxy;
 
 struct CodeCacheItem {
   enum Result {
@@ -22,11 +32,45 @@ struct CodeCacheItem {
     UPDATED
   };
 
-  std::unique_ptr<uint8_t> data = nullptr;
+  // Header and serialized bytecode produced by JS_WriteObject, pending a
+  // cache update.
+  std::vector<uint8_t> data;
+  // Mapped cache file, read in place by JS_ReadObject.
+  std::unique_ptr<MappedFile> mappedFile = nullptr;
+  // Fingerprint of the source, may still be computed on another thread.
+  std::shared_future<uint64_t> sourceFingerprint;
+  // Payload checksum check, only run with ENABLE_HASH_CHECK.
+  std::future<bool> payloadVerified;
+  // Payload size, excluding the header.
   size_t size = 0;
+  // Size of the payload prefix used at startup, 0 if not laid out in
+  // startup order.
+  size_t startupSize = 0;
   Result result = UNINITIALIZED;
 };
 
+// A bundle compiled while the startup is profiled. Its code cache is written
+// once the startup is over, with the functions that ran laid out first.
+struct PendingCodeCache {
+  std::string url;
+  JSValue func;
+  size_t sourceLength;
+  std::shared_future<uint64_t> sourceFingerprint;
+};
+
+// Progress of a microtask drain that yields between batches, see
+// QuickJSRuntime::drainMicrotasks(MicrotaskDrain &, ...).
+struct MicrotaskDrain {
+  // Jobs run so far.
+  size_t jobCount = 0;
+  // Time spent running them.
+  std::chrono::microseconds duration{0};
+  // Times the drain yielded with jobs left.
+  size_t yieldCount = 0;
+  // Set once the job queue is empty.
+  bool done = false;
+};
+
 class QuickJSRuntime : public jsi::Runtime {
  public:
   QuickJSRuntime(const std::string &codeCacheDir);
@@ -34,12 +78,39 @@ class QuickJSRuntime : public jsi::Runtime {
 
   std::unordered_map<std::string, int64_t> getHeapInfo();
 
+  // Runs tasks on the JS thread, e.g. through the JS MessageQueueThread.
+  // Lets the runtime write the code caches profiled at startup as soon as
+  // cache writes are no longer deferred, see setCodeCacheWriteDeferred().
+  // Without it, they are written by the next evaluateJavaScript().
+  using JSThreadScheduler = std::function<void(std::function<void()> &&task)>;
+  void setJSThreadScheduler(JSThreadScheduler scheduler);
+
+  // Takes over |proxy|, see createFastHostFunction() in FastHostFunction.h.
+  jsi::Function createFastHostFunction(
+      const jsi::PropNameID &name,
+      unsigned int paramCount,
+      FastHostFunctionProxy *proxy);
+
  private:
   void checkAndThrowException(JSContext *context) const;
   void loadCodeCache(CodeCacheItem &codeCacheItem, const std::string& url, const char *source,
                      size_t size);
-  void updateCodeCache(CodeCacheItem &codeCacheItem, const std::string& url, const char *source,
-                     size_t size);
+  void updateCodeCache(CodeCacheItem &codeCacheItem, const std::string& url, size_t sourceLength);
+  // Serializes |func| into codeCacheItem.data, after room for the header.
+  bool serializeCodeCache(CodeCacheItem &codeCacheItem, JSValueConst func, int flags);
+  void flushPendingCodeCaches();
+  // Writes the pending code caches on the JS thread once cache writes are
+  // no longer deferred.
+  void scheduleCodeCacheFlush();
+  // Checks the source fingerprint, waiting for the checks still running.
+  bool verifyCodeCache(CodeCacheItem &codeCacheItem);
+  jsi::Value evaluateBytecodeBundle(const std::shared_ptr<const jsi::Buffer> &buffer);
+  // Runs a compiled top-level function, consuming |func|, then drains the
+  // pending jobs.
+  jsi::Value evaluateFunction(JSValue func);
+  // Runs up to |maxCount| pending jobs, all of them if -1. Returns true once
+  // the job queue is empty.
+  bool runMicrotasks(int maxCount);
 
 
   //
@@ -97,6 +168,8 @@ class QuickJSRuntime : public jsi::Runtime {
 
   jsi::String createStringFromAscii(const char *str, size_t length) override;
   jsi::String createStringFromUtf8(const uint8_t *utf8, size_t length) override;
+
+  jsi::Value createValueFromJsonUtf8(const uint8_t *json, size_t length) override;
   std::string utf8(const jsi::String &) override;
 
   jsi::Object createObject() override;
@@ -129,11 +202,14 @@ class QuickJSRuntime : public jsi::Runtime {
   jsi::Value lockWeakObject(jsi::WeakObject &) override;
 
   jsi::Array createArray(size_t length) override;
+  // Creates the array from |count| values in one allocation.
+  jsi::Array createArray(const jsi::Value *elements, size_t count);
     jsi::ArrayBuffer createArrayBuffer(
       std::shared_ptr<jsi::MutableBuffer> buffer) override;
   size_t size(const jsi::Array &) override;
   size_t size(const jsi::ArrayBuffer &) override;
   uint8_t *data(const jsi::ArrayBuffer &) override;
+  uint8_t *data(const jsi::ArrayBuffer &arrayBuffer, size_t *size);
   jsi::Value getValueAtIndex(const jsi::Array &, size_t i) override;
   void setValueAtIndexImpl(jsi::Array &, size_t i, const jsi::Value &value)
       override;
@@ -142,6 +218,33 @@ class QuickJSRuntime : public jsi::Runtime {
       const jsi::PropNameID &name,
       unsigned int paramCount,
       jsi::HostFunctionType func) override;
+  // Memoizes the value of every property of the host object |object| on
+  // first read, for host objects that can't derive from
+  // MemoizedHostObject, e.g. TurboModules, whose methods don't change.
+  void setHostObjectMemoized(const jsi::Object &object, bool memoized);
+  // Drops the memoized value of |name|, or of all properties, of the host
+  // object |object|. The next read calls HostObject::get() again.
+  void invalidateHostObjectProperty(
+      const jsi::Object &object,
+      const jsi::PropNameID &name);
+  void invalidateHostObjectProperties(const jsi::Object &object);
+
+  // Runs the pending jobs in batches until the job queue is empty or
+  // |budget| is spent, then returns whether it is empty. The jobs left stay
+  // queued for the next call with the same |drain|, so the caller can
+  // handle input in between:
+  //
+  //   MicrotaskDrain drain;
+  //   while (!runtime.drainMicrotasks(drain, std::chrono::milliseconds(4))) {
+  //     ...
+  //   }
+  //
+  // A single job is never interrupted, the budget is checked between
+  // batches of kMicrotaskBatchSize jobs.
+  bool drainMicrotasks(MicrotaskDrain &drain, std::chrono::microseconds budget);
+
+  static constexpr int kMicrotaskBatchSize = 32;
+
   jsi::Value call(
       const jsi::Function &,
       const jsi::Value &jsThis,
@@ -161,7 +264,9 @@ class QuickJSRuntime : public jsi::Runtime {
 
  private:
   friend class QuickJSPointerValue;
+  friend class QuickJSAtomPointerValue;
   friend class JSIValueConverter;
+  friend class DynamicConverter;
 
  public:
   JSRuntime *getJSRuntime() const {
@@ -172,12 +277,32 @@ class QuickJSRuntime : public jsi::Runtime {
     return context_;
   };
 
+  PointerValuePool &getPointerValuePool() {
+    return pointerValuePool_;
+  };
+
  private:
   JSRuntime *runtime_;
   JSContext *context_;
+  PointerValuePool pointerValuePool_;
   std::string codeCacheDir_;
+  CodeCacheStore *codeCacheStore_ = nullptr;
+  std::vector<PendingCodeCache> pendingCodeCaches_;
+  JSThreadScheduler jsThreadScheduler_;
+  // Tasks posted to the JS thread only run while it is alive.
+  std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);
+  // Code cache mappings referenced by the bytecode of this runtime. Released
+  // only after runtime_ is freed.
+  std::vector<std::unique_ptr<MappedFile>> mappedCodeCaches_;
+  // Precompiled bundles whose bytecode is read lazily, same lifetime.
+  std::vector<std::shared_ptr<const jsi::Buffer>> bytecodeBundles_;
 
   std::unique_ptr<QuickJSInstrumentation> instrumentation_;
+
+  // Microtask counters, reported by the instrumentation.
+  uint64_t microtaskCount_ = 0;
+  std::chrono::microseconds microtaskDuration_{0};
+  uint64_t microtaskYieldCount_ = 0;
 };
 
 } // namespace qjs
@@ -1,6 +1,8 @@
 #include "QuickJSRuntimeFactory.h"
 
 #include "QuickJSRuntime.h"
+#include "CodeCacheStore.h"
+#include "CodeCacheWriter.h"
 #include <memory>
 
 namespace qjs {
@@ -9,4 +11,24 @@ std::unique_ptr<jsi::Runtime> createQuickJSRuntime(const std::string &codeCacheD
   return std::make_unique<QuickJSRuntime>(codeCacheDir);
 }
 
+std::unique_ptr<jsi::Runtime> createQuickJSRuntime(
+    const std::string &codeCacheDir,
+    std::function<void(std::function<void()> &&task)> jsThreadScheduler) {
+  auto runtime = std::make_unique<QuickJSRuntime>(codeCacheDir);
+  runtime->setJSThreadScheduler(std::move(jsThreadScheduler));
+  return runtime;
+}
+
+void setCodeCacheWriteDeferred(bool deferred) {
+  CodeCacheWriter::getInstance().setDeferred(deferred);
+}
+
+void setCodeCacheSizeBudget(size_t bytes) {
+  CodeCacheStore::setSizeBudget(bytes);
+}
+
+void setCodeCacheCompressed(bool compressed) {
+  CodeCacheStore::setCompression(compressed);
+}
+
 } // namespace qjs
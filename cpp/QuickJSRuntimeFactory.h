@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory.h>
+#include <functional>
 
 #include <jsi/jsi.h>
 
@@ -10,4 +11,23 @@ namespace qjs {
 
 std::unique_ptr<jsi::Runtime> createQuickJSRuntime(const std::string &codeCacheDir);
 
+// Same as above, with |jsThreadScheduler| running tasks on the JS thread so
+// the code caches profiled at startup are written as soon as
+// setCodeCacheWriteDeferred(false) is called.
+std::unique_ptr<jsi::Runtime> createQuickJSRuntime(
+    const std::string &codeCacheDir,
+    std::function<void(std::function<void()> &&task)> jsThreadScheduler);
+
+// Hold code cache writes back while |deferred| is set, e.g. from before the
+// bundle is loaded until the first frame is rendered.
+void setCodeCacheWriteDeferred(bool deferred);
+
+// Bound the code caches kept on disk, least recently used ones are evicted
+// first.
+void setCodeCacheSizeBudget(size_t bytes);
+
+// Compress the code caches written from now on. Worth it where storage is
+// slower than decompression, typically low-end devices with eMMC storage.
+void setCodeCacheCompressed(bool compressed);
+
 } // namespace qjs
@@ -30,6 +30,28 @@ class ScopedJSValue {
   JSValue *value_;
 };
 
+class ScopedJSAtom {
+ public:
+  explicit ScopedJSAtom(JSContext *context, JSAtom atom)
+      : context_(context), atom_(atom) {};
+
+  ~ScopedJSAtom() {
+    JS_FreeAtom(context_, atom_);
+  }
+
+  // Prevent copying of Scope objects.
+  ScopedJSAtom(const ScopedJSAtom &) = delete;
+  ScopedJSAtom &operator=(const ScopedJSAtom &) = delete;
+
+  JSAtom get() const {
+    return atom_;
+  };
+
+ private:
+  JSContext *context_;
+  JSAtom atom_;
+};
+
 class ScopedCString {
  public:
   explicit ScopedCString(JSContext *context, const char *cstring)
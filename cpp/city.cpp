@@ -29,8 +29,6 @@
 
 #include "city.h"
 
-#if ENABLE_HASH_CHECK
-
 #include <algorithm>
 #include <string.h>  // for memcpy and memset
 
@@ -664,5 +662,3 @@ uint128 CityHashCrc128(const char *s, size_t len) {
 
 }  // namespace cityhash
 }  // namespace base
-
-#endif
@@ -62,8 +62,6 @@
 #ifndef CITY_HASH_H_
 #define CITY_HASH_H_
 
-#if ENABLE_HASH_CHECK
-
 #include <stdlib.h>  // for size_t.
 #include <stdint.h>
 #include <utility>
@@ -118,6 +116,4 @@ inline uint64 Hash128to64(const uint128& x) {
 }  // namespace cityhash
 }  // namespace base
 
-#endif
-
 #endif  // CITY_HASH_H_
\ No newline at end of file
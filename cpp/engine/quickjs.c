@@ -206,6 +206,8 @@ typedef enum JSErrorEnum {
 
 #define JS_MAX_LOCAL_VARS 65536
 #define JS_STACK_SIZE_MAX 65534
+/* JS_NewArrayLength() only preallocates arrays up to this length */
+#define JS_ARRAY_PREALLOC_MAX 4096
 #define JS_STRING_LEN_MAX ((1 << 30) - 1)
 
 #define __exception __attribute__((warn_unused_result))
@@ -257,6 +259,7 @@ struct JSRuntime {
 
     int class_count;    /* size of class_array */
     JSClass *class_array;
+    JSNativeStateFinalizer *native_state_finalizer;
 
     struct list_head context_list; /* list of JSContext.link */
     /* list of JSGCObjectHeader.link. List of allocated GC objects (used
@@ -294,6 +297,8 @@ struct JSRuntime {
     void *module_loader_opaque;
 
     BOOL can_block : 8; /* TRUE if Atomics.wait can block */
+    /* mark the functions that are executed, see JS_SetStartupProfiling() */
+    BOOL profile_startup : 8;
     /* used to allocate, free and clone SharedArrayBuffers */
     JSSharedArrayBufferFunctions sab_funcs;
     
@@ -607,7 +612,11 @@ typedef struct JSFunctionBytecode {
     uint8_t has_debug : 1;
     uint8_t backtrace_barrier : 1; /* stop backtrace on this function */
     uint8_t read_only_bytecode : 1;
-    /* XXX: 4 bits available */
+    /* not read yet from its serialized form, see JSLazyFunction */
+    uint8_t is_lazy : 1;
+    /* executed while the startup was profiled */
+    uint8_t is_startup : 1;
+    /* XXX: 2 bits available */
     uint8_t *byte_code_buf; /* (self pointer) */
     int byte_code_len;
     JSAtom func_name;
@@ -632,6 +641,33 @@ typedef struct JSFunctionBytecode {
     } debug;
 } JSFunctionBytecode;
 
+/* buffer read with JS_READ_OBJ_LAZY: shared by all the functions which
+   are still to be read from it */
+typedef struct JSLazySource {
+    int ref_count;
+    const uint8_t *buf_start, *buf_end;
+    uint32_t first_atom;
+    uint32_t idx_to_atom_count;
+    JSAtom *idx_to_atom;
+    BOOL is_rom_data : 8;
+    BOOL relocate_in_place : 8;
+} JSLazySource;
+
+/* A lazy function is a JSFunctionBytecode with only the fields up to
+   'debug' and is_lazy set. This structure is stored in place of the
+   debug info. It is replaced by the actual function the first time it
+   is loaded from the constant pool. */
+typedef struct JSLazyFunction {
+    JSLazySource *source;
+    uint32_t offset; /* position of the function record in the buffer */
+    BOOL failed; /* the buffer may be partially relocated: never retry */
+} JSLazyFunction;
+
+static inline JSLazyFunction *js_get_lazy_function(JSFunctionBytecode *b)
+{
+    return (JSLazyFunction *)&b->debug;
+}
+
 typedef struct JSBoundFunction {
     JSValue func_obj;
     JSValue this_val;
@@ -849,6 +885,12 @@ typedef struct JSInterceptor {
     JSObject *enumerator; /* NULL if undefined */
 } JSInterceptor;
 
+/* optional data of an object, allocated on first use */
+typedef struct JSObjectExtra {
+    void *native_state; /* see JS_SetNativeState() */
+    JSObject *memo; /* see JS_SetMemoizedProperty() */
+} JSObjectExtra;
+
 #define JS_PROP_INITIAL_SIZE 2
 #define JS_PROP_INITIAL_HASH_SIZE 4 /* must be a power of two */
 #define JS_ARRAY_INITIAL_SIZE 2
@@ -902,6 +944,7 @@ struct JSObject {
     JSShape *shape; /* prototype and property names + flag */
     JSProperty *prop; /* array of properties */
     JSInterceptor *interceptor;
+    JSObjectExtra *extra; /* NULL if none */
     /* byte offsets: 24/40 */
     struct JSMapRecord *first_weak_ref; /* XXX: use a bit and an external hash table? */
     /* byte offsets: 28/48 */
@@ -1018,6 +1061,8 @@ static JSAtom __JS_NewAtomInit(JSRuntime *rt, const char *str, int len,
                                int atom_type);
 static void JS_FreeAtomStruct(JSRuntime *rt, JSAtomStruct *p);
 static void free_function_bytecode(JSRuntime *rt, JSFunctionBytecode *b);
+static void js_lazy_source_free(JSRuntime *rt, JSLazySource *ls);
+static int js_load_lazy_function(JSContext *ctx, JSValue *pval);
 static JSValue js_call_c_function(JSContext *ctx, JSValueConst func_obj,
                                   JSValueConst this_obj,
                                   int argc, JSValueConst *argv, int flags);
@@ -1814,6 +1859,11 @@ void JS_SetCanBlock(JSRuntime *rt, BOOL can_block)
     rt->can_block = can_block;
 }
 
+void JS_SetStartupProfiling(JSRuntime *rt, BOOL enable)
+{
+    rt->profile_startup = enable;
+}
+
 void JS_SetSharedArrayBufferFunctions(JSRuntime *rt,
                                       const JSSharedArrayBufferFunctions *sf)
 {
@@ -1877,6 +1927,40 @@ int JS_ExecutePendingJob(JSRuntime *rt, JSContext **pctx)
     return ret;
 }
 
+/* Execute up to 'max_jobs' pending jobs, or all of them including the jobs
+   they enqueue if 'max_jobs' < 0. Stops at the first job that throws. The
+   number of executed jobs, including the one that threw, is stored in
+   '*pcount' and the context of the last one in '*pctx'. return < 0 if
+   exception, 0 if no job is pending anymore, 1 if jobs remain. */
+int JS_ExecutePendingJobs(JSRuntime *rt, int max_jobs, int *pcount,
+                          JSContext **pctx)
+{
+    JSContext *ctx = NULL;
+    JSJobEntry *e;
+    JSValue res;
+    int i, count;
+
+    for(count = 0; count != max_jobs && !list_empty(&rt->job_list); ) {
+        e = list_entry(rt->job_list.next, JSJobEntry, link);
+        list_del(&e->link);
+        ctx = e->ctx;
+        res = e->job_func(e->ctx, e->argc, (JSValueConst *)e->argv);
+        for(i = 0; i < e->argc; i++)
+            JS_FreeValue(ctx, e->argv[i]);
+        js_free(ctx, e);
+        count++;
+        if (JS_IsException(res)) {
+            *pcount = count;
+            *pctx = ctx;
+            return -1;
+        }
+        JS_FreeValue(ctx, res);
+    }
+    *pcount = count;
+    *pctx = ctx;
+    return !list_empty(&rt->job_list);
+}
+
 static inline uint32_t atom_get_free(const JSAtomStruct *p)
 {
     return (uintptr_t)p >> 1;
@@ -4882,6 +4966,7 @@ static JSValue JS_NewObjectFromShape(JSContext *ctx, JSShape *sh, JSClassID clas
     }
 
     p->interceptor = NULL;
+    p->extra = NULL;
 
     switch(class_id) {
     case JS_CLASS_OBJECT:
@@ -5576,6 +5661,16 @@ static void free_object(JSRuntime *rt, JSObject *p)
         reset_weak_ref(rt, p);
     }
 
+    if (p->extra) {
+        JSObjectExtra *extra = p->extra;
+        p->extra = NULL;
+        if (extra->native_state)
+            rt->native_state_finalizer(rt, extra->native_state);
+        if (extra->memo)
+            JS_FreeValueRT(rt, JS_MKPTR(JS_TAG_OBJECT, extra->memo));
+        js_free_rt(rt, extra);
+    }
+
     finalizer = rt->class_array[p->class_id].finalizer;
     if (finalizer)
         (*finalizer)(rt, JS_MKPTR(JS_TAG_OBJECT, p));
@@ -5787,6 +5882,8 @@ static void mark_children(JSRuntime *rt, JSGCObjectHeader *gp,
                 if (interceptor->enumerator)
                     mark_func(rt, &interceptor->enumerator->header);
             }
+            if (p->extra && p->extra->memo)
+                mark_func(rt, &p->extra->memo->header);
 
             if (p->class_id != JS_CLASS_OBJECT) {
                 JSClassGCMark *gc_mark;
@@ -7290,6 +7387,13 @@ JSValue JS_GetPropertyInternal(JSContext *ctx, JSValueConst obj,
 
     JSInterceptor *interceptor = get_interceptor(p);
     if (interceptor && interceptor->getter) {
+        /* values memoized by the host are read without calling the
+           interceptor */
+        if (p->extra && p->extra->memo) {
+            prs = find_own_property(&pr, p->extra->memo, prop);
+            if (prs)
+                return JS_DupValue(ctx, pr->u.value);
+        }
         JSValue name = JS_AtomToValue(ctx, prop);
         JSValue func = JS_MKPTR(JS_TAG_OBJECT, interceptor->getter);
         func = JS_DupValue(ctx, func);
@@ -7628,6 +7732,56 @@ void __JS_FreeEnumArray(JSContext *ctx, JSPropertyEnum *tab, uint32_t len)
    js_free_prop_enum(ctx, tab, len);
 }
 
+/* Fast path to read the own enumerable string keyed properties of a plain
+   object straight from its shape. Return the number of property slots, or
+   -1 if 'obj' is not a plain object or has enumerable accessor, variable
+   reference or lazily initialized properties, in which case
+   JS_GetOwnPropertyNames() must be used. */
+int JS_GetShapePropertyCount(JSContext *ctx, JSValueConst obj)
+{
+    JSObject *p;
+    JSShape *sh;
+    JSShapeProperty *prs;
+    int i;
+
+    if (JS_VALUE_GET_TAG(obj) != JS_TAG_OBJECT)
+        return -1;
+    p = JS_VALUE_GET_OBJ(obj);
+    if (p->class_id != JS_CLASS_OBJECT)
+        return -1;
+    sh = p->shape;
+    for(i = 0, prs = get_shape_prop(sh); i < sh->prop_count; i++, prs++) {
+        if (prs->atom != JS_ATOM_NULL &&
+            (prs->flags & JS_PROP_ENUMERABLE) &&
+            (prs->flags & JS_PROP_TMASK) != JS_PROP_NORMAL)
+            return -1;
+    }
+    return sh->prop_count;
+}
+
+/* Read the slot 'idx' of the shape of the plain object 'obj'. Return FALSE
+   for deleted, non-enumerable, non data and symbol keyed slots. The slots
+   are re-read on each call, so the object may be modified in between.
+   'patom' and 'pvalue' are not duplicated. */
+JS_BOOL JS_GetShapeProperty(JSContext *ctx, JSValueConst obj, int idx,
+                            JSAtom *patom, JSValueConst *pvalue)
+{
+    JSObject *p = JS_VALUE_GET_OBJ(obj);
+    JSShapeProperty *prs;
+
+    if (idx >= p->shape->prop_count)
+        return FALSE;
+    prs = get_shape_prop(p->shape) + idx;
+    if (prs->atom == JS_ATOM_NULL ||
+        !(prs->flags & JS_PROP_ENUMERABLE) ||
+        (prs->flags & JS_PROP_TMASK) != JS_PROP_NORMAL ||
+        !JS_AtomIsString(ctx, prs->atom))
+        return FALSE;
+    *patom = prs->atom;
+    *pvalue = p->prop[idx].u.value;
+    return TRUE;
+}
+
 /* return < 0 in case if exception, 0 if OK. ptab and its atoms must
    be freed by the user. */
 static int __exception JS_GetOwnPropertyNamesInternal(JSContext *ctx,
@@ -8487,6 +8641,60 @@ static int add_fast_array_element(JSContext *ctx, JSObject *p,
     return TRUE;
 }
 
+/* Create an empty fast array with room for 'len' elements */
+static JSValue js_new_fast_array(JSContext *ctx, uint32_t len)
+{
+    JSValue obj;
+
+    if (len > INT32_MAX)
+        return JS_ThrowRangeError(ctx, "invalid array length");
+    obj = JS_NewArray(ctx);
+    if (JS_IsException(obj) || len == 0)
+        return obj;
+    if (expand_fast_array(ctx, JS_VALUE_GET_OBJ(obj), len)) {
+        JS_FreeValue(ctx, obj);
+        return JS_EXCEPTION;
+    }
+    return obj;
+}
+
+/* Create an array of length 'len' whose elements can then be set in
+   order without reallocating. Like 'new Array(len)', a large length is
+   not allocated up front. */
+JSValue JS_NewArrayLength(JSContext *ctx, uint32_t len)
+{
+    JSValue obj;
+
+    if (len > INT32_MAX)
+        return JS_ThrowRangeError(ctx, "invalid array length");
+    obj = js_new_fast_array(ctx, min_uint32(len, JS_ARRAY_PREALLOC_MAX));
+    if (!JS_IsException(obj))
+        JS_VALUE_GET_OBJ(obj)->prop[0].u.value = JS_NewUint32(ctx, len);
+    return obj;
+}
+
+/* Create a fast array holding the 'len' values of 'tab'. The values are
+   taken over, or freed on failure. */
+JSValue JS_NewArrayFrom(JSContext *ctx, uint32_t len, JSValue *tab)
+{
+    JSValue obj;
+    JSObject *p;
+    uint32_t i;
+
+    obj = js_new_fast_array(ctx, len);
+    if (JS_IsException(obj)) {
+        for(i = 0; i < len; i++)
+            JS_FreeValue(ctx, tab[i]);
+        return obj;
+    }
+    p = JS_VALUE_GET_OBJ(obj);
+    if (len > 0)
+        memcpy(p->u.array.u.values, tab, sizeof(tab[0]) * len);
+    p->u.array.count = len;
+    p->prop[0].u.value = JS_NewUint32(ctx, len);
+    return obj;
+}
+
 static void js_free_desc(JSContext *ctx, JSPropertyDescriptor *desc)
 {
     JS_FreeValue(ctx, desc->getter);
@@ -10043,6 +10251,109 @@ void *JS_GetOpaqueUnsafe(JSValueConst obj)
     return p->u.opaque;
 }
 
+void JS_SetNativeStateFinalizer(JSRuntime *rt, JSNativeStateFinalizer *finalizer)
+{
+    rt->native_state_finalizer = finalizer;
+}
+
+static JSObjectExtra *get_object_extra(JSContext *ctx, JSObject *p)
+{
+    if (!p->extra)
+        p->extra = js_mallocz(ctx, sizeof(JSObjectExtra));
+    return p->extra;
+}
+
+/* Unlike the opaque pointer, works with objects of any class. The previous
+   state, if any, is finalized. */
+int JS_SetNativeState(JSContext *ctx, JSValueConst obj, void *state)
+{
+    JSObject *p;
+    JSObjectExtra *extra;
+    void *old_state;
+    if (JS_VALUE_GET_TAG(obj) != JS_TAG_OBJECT) {
+        JS_ThrowTypeErrorNotAnObject(ctx);
+        return -1;
+    }
+    if (state && !ctx->rt->native_state_finalizer) {
+        JS_ThrowInternalError(ctx, "no native state finalizer");
+        return -1;
+    }
+    p = JS_VALUE_GET_OBJ(obj);
+    if (!state && !p->extra)
+        return 0;
+    extra = get_object_extra(ctx, p);
+    if (!extra)
+        return -1;
+    old_state = extra->native_state;
+    extra->native_state = state;
+    if (old_state)
+        ctx->rt->native_state_finalizer(ctx->rt, old_state);
+    return 0;
+}
+
+void *JS_GetNativeState(JSValueConst obj)
+{
+    JSObjectExtra *extra;
+    if (JS_VALUE_GET_TAG(obj) != JS_TAG_OBJECT)
+        return NULL;
+    extra = JS_VALUE_GET_OBJ(obj)->extra;
+    return extra ? extra->native_state : NULL;
+}
+
+/* Memoized values are kept apart from the properties of the object, in a
+   table keyed by atom. For objects with an interceptor getter, they are
+   returned without calling it. Takes over 'val'. */
+int JS_SetMemoizedProperty(JSContext *ctx, JSValueConst obj, JSAtom prop,
+                           JSValue val)
+{
+    JSObjectExtra *extra;
+    JSValue memo;
+    if (JS_VALUE_GET_TAG(obj) != JS_TAG_OBJECT) {
+        JS_FreeValue(ctx, val);
+        JS_ThrowTypeErrorNotAnObject(ctx);
+        return -1;
+    }
+    extra = get_object_extra(ctx, JS_VALUE_GET_OBJ(obj));
+    if (!extra) {
+        JS_FreeValue(ctx, val);
+        return -1;
+    }
+    if (!extra->memo) {
+        memo = JS_NewObjectProto(ctx, JS_NULL);
+        if (JS_IsException(memo)) {
+            JS_FreeValue(ctx, val);
+            return -1;
+        }
+        extra->memo = JS_VALUE_GET_OBJ(memo);
+    }
+    return JS_DefinePropertyValue(ctx, JS_MKPTR(JS_TAG_OBJECT, extra->memo),
+                                  prop, val, JS_PROP_C_W_E);
+}
+
+void JS_DeleteMemoizedProperty(JSContext *ctx, JSValueConst obj, JSAtom prop)
+{
+    JSObjectExtra *extra;
+    if (JS_VALUE_GET_TAG(obj) != JS_TAG_OBJECT)
+        return;
+    extra = JS_VALUE_GET_OBJ(obj)->extra;
+    if (extra && extra->memo)
+        delete_property(ctx, extra->memo, prop);
+}
+
+void JS_ClearMemoizedProperties(JSContext *ctx, JSValueConst obj)
+{
+    JSObjectExtra *extra;
+    JSObject *memo;
+    if (JS_VALUE_GET_TAG(obj) != JS_TAG_OBJECT)
+        return;
+    extra = JS_VALUE_GET_OBJ(obj)->extra;
+    if (extra && extra->memo) {
+        memo = extra->memo;
+        extra->memo = NULL;
+        JS_FreeValue(ctx, JS_MKPTR(JS_TAG_OBJECT, memo));
+    }
+}
+
 #define HINT_STRING  0
 #define HINT_NUMBER  1
 #define HINT_NONE    2
@@ -15811,6 +16122,12 @@ static BOOL js_get_fast_array(JSContext *ctx, JSValueConst obj,
     return FALSE;
 }
 
+JS_BOOL JS_GetFastArray(JSContext *ctx, JSValueConst obj,
+                        JSValue **parray, uint32_t *plen)
+{
+    return js_get_fast_array(ctx, obj, parray, plen);
+}
+
 static __exception int js_append_enumerate(JSContext *ctx, JSValue *sp)
 {
     JSValue iterator, enumobj, method, value;
@@ -16002,6 +16319,15 @@ static JSVarRef *get_var_ref(JSContext *ctx, JSStackFrame *sf,
     return var_ref;
 }
 
+/* load a lazy function of the constant pool in place */
+static inline int js_resolve_cpool(JSContext *ctx, JSValue *pval)
+{
+    if (unlikely(JS_VALUE_GET_TAG(*pval) == JS_TAG_FUNCTION_BYTECODE &&
+                 ((JSFunctionBytecode *)JS_VALUE_GET_PTR(*pval))->is_lazy))
+        return js_load_lazy_function(ctx, pval);
+    return 0;
+}
+
 static JSValue js_closure2(JSContext *ctx, JSValue func_obj,
                            JSFunctionBytecode *b,
                            JSVarRef **cur_var_refs,
@@ -16079,6 +16405,10 @@ static JSValue js_closure(JSContext *ctx, JSValue bfunc,
     JSAtom name_atom;
 
     b = JS_VALUE_GET_PTR(bfunc);
+    /* functions created at startup are also loaded at startup, e.g. the
+       module factories, even if they are not called */
+    if (unlikely(ctx->rt->profile_startup))
+        b->is_startup = TRUE;
     func_obj = JS_NewObjectClass(ctx, func_kind_to_class_id[b->func_kind]);
     if (JS_IsException(func_obj)) {
         JS_FreeValue(ctx, bfunc);
@@ -16548,6 +16878,8 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                          (JSValueConst *)argv, flags);
     }
     b = p->u.func.function_bytecode;
+    if (unlikely(rt->profile_startup))
+        b->is_startup = TRUE;
 
     if (unlikely(argc < b->arg_count || (flags & JS_CALL_FLAG_COPY_ARGV))) {
         arg_allocated_size = b->arg_count;
@@ -16602,6 +16934,8 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
             pc += 4;
             BREAK;
         CASE(OP_push_const):
+            if (unlikely(js_resolve_cpool(ctx, &b->cpool[get_u32(pc)])))
+                goto exception;
             *sp++ = JS_DupValue(ctx, b->cpool[get_u32(pc)]);
             pc += 4;
             BREAK;
@@ -16626,9 +16960,13 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
             pc += 2;
             BREAK;
         CASE(OP_push_const8):
+            if (unlikely(js_resolve_cpool(ctx, &b->cpool[*pc])))
+                goto exception;
             *sp++ = JS_DupValue(ctx, b->cpool[*pc++]);
             BREAK;
         CASE(OP_fclosure8):
+            if (unlikely(js_resolve_cpool(ctx, &b->cpool[*pc])))
+                goto exception;
             *sp++ = js_closure(ctx, JS_DupValue(ctx, b->cpool[*pc++]), var_refs, sf);
             if (unlikely(JS_IsException(sp[-1])))
                 goto exception;
@@ -16891,7 +17229,10 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
 
         CASE(OP_fclosure):
             {
-                JSValue bfunc = JS_DupValue(ctx, b->cpool[get_u32(pc)]);
+                JSValue bfunc;
+                if (unlikely(js_resolve_cpool(ctx, &b->cpool[get_u32(pc)])))
+                    goto exception;
+                bfunc = JS_DupValue(ctx, b->cpool[get_u32(pc)]);
                 pc += 4;
                 *sp++ = js_closure(ctx, bfunc, var_refs, sf);
                 if (unlikely(JS_IsException(sp[-1])))
@@ -32965,6 +33306,9 @@ static void free_function_bytecode(JSRuntime *rt, JSFunctionBytecode *b)
                JS_AtomGetStrRT(rt, buf, sizeof(buf), b->func_name));
     }
 #endif
+    if (b->is_lazy)
+        js_lazy_source_free(rt, js_get_lazy_function(b)->source);
+
     free_bytecode_atoms(rt, b->byte_code_buf, b->byte_code_len, TRUE);
 
     if (b->vardefs) {
@@ -34151,12 +34495,15 @@ typedef enum BCTagEnum {
     BC_TAG_DATE,
     BC_TAG_OBJECT_VALUE,
     BC_TAG_OBJECT_REFERENCE,
+    BC_TAG_FUNCTION_REFERENCE,
 } BCTagEnum;
 
+/* 3 and 4: function records are prefixed with their length
+   5 and 4: BC_TAG_FUNCTION_REFERENCE */
 #ifdef CONFIG_BIGNUM
-#define BC_BASE_VERSION 2
+#define BC_BASE_VERSION 5
 #else
-#define BC_BASE_VERSION 1
+#define BC_BASE_VERSION 4
 #endif
 #define BC_BE_VERSION 0x40
 #ifdef WORDS_BIGENDIAN
@@ -34165,6 +34512,11 @@ typedef enum BCTagEnum {
 #define BC_VERSION BC_BASE_VERSION
 #endif
 
+typedef struct BCColdFunction {
+    JSValueConst func;
+    size_t ref_pos; /* position of the offset to patch */
+} BCColdFunction;
+
 typedef struct BCWriterState {
     JSContext *ctx;
     DynBuf dbuf;
@@ -34183,6 +34535,13 @@ typedef struct BCWriterState {
     int sab_tab_size;
     /* list of referenced objects (used if allow_reference = TRUE) */
     JSObjectList object_list;
+    /* JS_WRITE_OBJ_STARTUP_LAYOUT: the functions which did not run during
+       the startup are written after the ones which did */
+    BOOL startup_layout : 8;
+    BOOL in_cold_section : 8;
+    BCColdFunction *cold_funcs;
+    int cold_funcs_count;
+    int cold_funcs_size;
 } BCWriterState;
 
 #ifdef DUMP_READ_OBJECT
@@ -34209,6 +34568,7 @@ static const char * const bc_tag_str[] = {
     "Date",
     "ObjectValue",
     "ObjectReference",
+    "FunctionReference",
 };
 #endif
 
@@ -34566,13 +34926,62 @@ static int JS_WriteBigNum(BCWriterState *s, JSValueConst obj)
 
 static int JS_WriteObjectRec(BCWriterState *s, JSValueConst obj);
 
+/* the function is written in the cold section, after the root object.
+   The reference holds its offset relative to the reference. */
+static int JS_WriteColdFunctionReference(BCWriterState *s, JSValueConst obj)
+{
+    BCColdFunction *cf;
+
+    if (js_resize_array(s->ctx, (void **)&s->cold_funcs,
+                        sizeof(s->cold_funcs[0]),
+                        &s->cold_funcs_size, s->cold_funcs_count + 1))
+        return -1;
+    bc_put_u8(s, BC_TAG_FUNCTION_REFERENCE);
+    cf = &s->cold_funcs[s->cold_funcs_count++];
+    cf->func = obj;
+    cf->ref_pos = s->dbuf.size;
+    bc_put_u32(s, 0);
+    return 0;
+}
+
+/* the functions of the cold section and their children are all written
+   inline, so that no new reference is added */
+static int JS_WriteColdSection(BCWriterState *s)
+{
+    BCColdFunction *cf;
+    uint32_t offset;
+    int i;
+
+    s->in_cold_section = TRUE;
+    for(i = 0; i < s->cold_funcs_count; i++) {
+        cf = &s->cold_funcs[i];
+        if (s->dbuf.size - cf->ref_pos > UINT32_MAX) {
+            JS_ThrowInternalError(s->ctx, "bytecode is too large");
+            return -1;
+        }
+        offset = s->dbuf.size - cf->ref_pos;
+        if (JS_WriteObjectRec(s, cf->func))
+            return -1;
+        if (s->dbuf.error)
+            return -1;
+        if (s->byte_swap)
+            offset = bswap32(offset);
+        put_u32(s->dbuf.buf + cf->ref_pos, offset);
+    }
+    return 0;
+}
+
 static int JS_WriteFunctionTag(BCWriterState *s, JSValueConst obj)
 {
     JSFunctionBytecode *b = JS_VALUE_GET_PTR(obj);
-    uint32_t flags;
+    uint32_t flags, len;
     int idx, i;
+    size_t len_pos;
     
     bc_put_u8(s, BC_TAG_FUNCTION_BYTECODE);
+    /* record length, patched below so that a reader can skip it */
+    len_pos = s->dbuf.size;
+    bc_put_u32(s, 0);
     flags = idx = 0;
     bc_set_flags(&flags, &idx, b->has_prototype, 1);
     bc_set_flags(&flags, &idx, b->has_simple_parameter_list, 1);
@@ -34644,9 +35053,24 @@ static int JS_WriteFunctionTag(BCWriterState *s, JSValueConst obj)
     }
     
     for(i = 0; i < b->cpool_count; i++) {
+        if (js_resolve_cpool(s->ctx, &b->cpool[i]))
+            goto fail;
+        if (s->startup_layout && !s->in_cold_section &&
+            JS_VALUE_GET_TAG(b->cpool[i]) == JS_TAG_FUNCTION_BYTECODE &&
+            !((JSFunctionBytecode *)JS_VALUE_GET_PTR(b->cpool[i]))->is_startup) {
+            if (JS_WriteColdFunctionReference(s, b->cpool[i]))
+                goto fail;
+            continue;
+        }
         if (JS_WriteObjectRec(s, b->cpool[i]))
             goto fail;
     }
+    if (!s->dbuf.error) {
+        len = s->dbuf.size - len_pos - 4;
+        if (s->byte_swap)
+            len = bswap32(len);
+        put_u32(s->dbuf.buf + len_pos, len);
+    }
     return 0;
  fail:
     return -1;
@@ -35005,8 +35429,17 @@ static int JS_WriteObjectAtoms(BCWriterState *s)
 
 uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
                          int flags, uint8_t ***psab_tab, size_t *psab_tab_len)
+{
+    return JS_WriteObject3(ctx, psize, obj, flags, psab_tab, psab_tab_len,
+                           NULL);
+}
+
+uint8_t *JS_WriteObject3(JSContext *ctx, size_t *psize, JSValueConst obj,
+                         int flags, uint8_t ***psab_tab, size_t *psab_tab_len,
+                         size_t *pstartup_size)
 {
     BCWriterState ss, *s = &ss;
+    size_t startup_size, objects_size;
 
     memset(s, 0, sizeof(*s));
     s->ctx = ctx;
@@ -35015,6 +35448,8 @@ uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
     s->allow_bytecode = ((flags & JS_WRITE_OBJ_BYTECODE) != 0);
     s->allow_sab = ((flags & JS_WRITE_OBJ_SAB) != 0);
     s->allow_reference = ((flags & JS_WRITE_OBJ_REFERENCE) != 0);
+    s->startup_layout = ((flags & JS_WRITE_OBJ_STARTUP_LAYOUT) != 0) &&
+        s->allow_bytecode && !s->allow_reference;
     /* XXX: could use a different version when bytecode is included */
     if (s->allow_bytecode)
         s->first_atom = JS_ATOM_END;
@@ -35025,12 +35460,21 @@ uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
     
     if (JS_WriteObjectRec(s, obj))
         goto fail;
+    startup_size = s->dbuf.size;
+    if (JS_WriteColdSection(s))
+        goto fail;
+    objects_size = s->dbuf.size;
     if (JS_WriteObjectAtoms(s))
         goto fail;
+    /* the atoms are moved in front of the objects */
+    startup_size += s->dbuf.size - objects_size;
     js_object_list_end(ctx, &s->object_list);
     js_free(ctx, s->atom_to_idx);
     js_free(ctx, s->idx_to_atom);
+    js_free(ctx, s->cold_funcs);
     *psize = s->dbuf.size;
+    if (pstartup_size)
+        *pstartup_size = startup_size;
     if (psab_tab)
         *psab_tab = s->sab_tab;
     if (psab_tab_len)
@@ -35040,8 +35484,11 @@ uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
     js_object_list_end(ctx, &s->object_list);
     js_free(ctx, s->atom_to_idx);
     js_free(ctx, s->idx_to_atom);
+    js_free(ctx, s->cold_funcs);
     dbuf_free(&s->dbuf);
     *psize = 0;
+    if (pstartup_size)
+        *pstartup_size = 0;
     if (psab_tab)
         *psab_tab = NULL;
     if (psab_tab_len)
@@ -35049,6 +35496,12 @@ uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
     return NULL;
 }
 
+uint32_t JS_GetBytecodeVersion(void)
+{
+    /* the predefined atoms and the opcodes are not serialized */
+    return BC_VERSION | (JS_ATOM_END << 8) | ((uint32_t)OP_COUNT << 20);
+}
+
 uint8_t *JS_WriteObject(JSContext *ctx, size_t *psize, JSValueConst obj,
                         int flags)
 {
@@ -35066,6 +35519,10 @@ typedef struct BCReaderState {
     BOOL allow_bytecode : 8;
     BOOL is_rom_data : 8;
     BOOL allow_reference : 8;
+    /* ROM data whose atoms are relocated directly in 'buf' */
+    BOOL relocate_in_place : 8;
+    /* if not NULL, the functions of the constant pools are read lazily */
+    JSLazySource *lazy_source;
     /* object references */
     JSObject **objects;
     int objects_count;
@@ -35320,9 +35777,18 @@ static int JS_ReadFunctionBytecode(BCReaderState *s, JSFunctionBytecode *b,
         case OP_FMT_atom_label_u8:
         case OP_FMT_atom_label_u16:
             idx = get_u32(bc_buf + pos + 1);
-            if (s->is_rom_data) {
+            if (s->is_rom_data && !s->relocate_in_place) {
                 /* just increment the reference count of the atom */
                 JS_DupAtom(s->ctx, (JSAtom)idx);
+            } else if (s->is_rom_data) {
+                if (bc_idx_to_atom(s, &atom, idx)) {
+                    b->byte_code_len = pos;
+                    return -1;
+                }
+                /* skip the write if the atom kept its index. Few
+                   do, so most bytecode pages still get dirty */
+                if (atom != idx)
+                    put_u32(bc_buf + pos + 1, atom);
             } else {
                 if (bc_idx_to_atom(s, &atom, idx)) {
                     /* Note: the atoms will be freed up to this position */
@@ -35496,6 +35962,115 @@ static int BC_add_object_ref(BCReaderState *s, JSValueConst obj)
     return BC_add_object_ref1(s, JS_VALUE_GET_OBJ(obj));
 }
 
+static JSValue JS_ReadFunctionTag(BCReaderState *s);
+
+static void js_lazy_source_free(JSRuntime *rt, JSLazySource *ls)
+{
+    int i;
+
+    if (--ls->ref_count > 0)
+        return;
+    for(i = 0; i < ls->idx_to_atom_count; i++)
+        JS_FreeAtomRT(rt, ls->idx_to_atom[i]);
+    js_free_rt(rt, ls->idx_to_atom);
+    js_free_rt(rt, ls);
+}
+
+/* create a lazy function for the function record at 'tag_ptr' */
+static JSValue js_new_lazy_function(BCReaderState *s, const uint8_t *tag_ptr)
+{
+    JSContext *ctx = s->ctx;
+    JSFunctionBytecode *b;
+    JSLazyFunction *lf;
+
+    b = js_mallocz(ctx, offsetof(JSFunctionBytecode, debug) +
+                   sizeof(JSLazyFunction));
+    if (!b)
+        return JS_EXCEPTION;
+    b->header.ref_count = 1;
+    b->is_lazy = TRUE;
+    lf = js_get_lazy_function(b);
+    lf->source = s->lazy_source;
+    lf->source->ref_count++;
+    lf->offset = tag_ptr + 1 - s->buf_start;
+    add_gc_object(ctx->rt, &b->header, JS_GC_OBJ_TYPE_FUNCTION_BYTECODE);
+    return JS_MKPTR(JS_TAG_FUNCTION_BYTECODE, b);
+}
+
+/* only record the position of the function, it is read by
+   js_load_lazy_function() when first used */
+static JSValue JS_ReadLazyFunctionTag(BCReaderState *s)
+{
+    const uint8_t *tag_ptr = s->ptr;
+    uint32_t record_len;
+
+    s->ptr++; /* BC_TAG_FUNCTION_BYTECODE */
+    if (bc_get_u32(s, &record_len))
+        return JS_EXCEPTION;
+    if (unlikely(s->buf_end - s->ptr < record_len)) {
+        bc_read_error_end(s);
+        return JS_EXCEPTION;
+    }
+    bc_read_trace(s, "lazy function, %u bytes\n", record_len);
+    s->ptr += record_len;
+    return js_new_lazy_function(s, tag_ptr);
+}
+
+/* return the function record a BC_TAG_FUNCTION_REFERENCE points to. The
+   references only point forward, so they can't loop. */
+static const uint8_t *bc_get_function_reference(BCReaderState *s)
+{
+    const uint8_t *ref_ptr = s->ptr;
+    uint32_t offset;
+
+    if (bc_get_u32(s, &offset))
+        return NULL;
+    if (offset < 4 || offset >= s->buf_end - ref_ptr ||
+        ref_ptr[offset] != BC_TAG_FUNCTION_BYTECODE) {
+        JS_ThrowSyntaxError(s->ctx, "invalid function reference");
+        s->error_state = -1;
+        return NULL;
+    }
+    return ref_ptr + offset;
+}
+
+/* replace the lazy function '*pval' by the function read from its buffer */
+static int js_load_lazy_function(JSContext *ctx, JSValue *pval)
+{
+    JSFunctionBytecode *b = JS_VALUE_GET_PTR(*pval);
+    JSLazyFunction *lf = js_get_lazy_function(b);
+    JSLazySource *ls = lf->source;
+    BCReaderState ss, *s = &ss;
+    JSValue obj;
+
+    if (lf->failed) {
+        JS_ThrowInternalError(ctx, "could not read lazy function");
+        return -1;
+    }
+    memset(s, 0, sizeof(*s));
+    s->ctx = ctx;
+    s->buf_start = ls->buf_start;
+    s->buf_end = ls->buf_end;
+    s->ptr = ls->buf_start + lf->offset;
+    s->first_atom = ls->first_atom;
+    s->idx_to_atom_count = ls->idx_to_atom_count;
+    s->idx_to_atom = ls->idx_to_atom;
+    s->allow_bytecode = TRUE;
+    s->is_rom_data = ls->is_rom_data;
+    s->relocate_in_place = ls->relocate_in_place;
+    s->lazy_source = ls;
+    obj = JS_ReadFunctionTag(s);
+    if (JS_IsException(obj)) {
+        lf->failed = TRUE;
+        return -1;
+    }
+    if (unlikely(ctx->rt->profile_startup))
+        ((JSFunctionBytecode *)JS_VALUE_GET_PTR(obj))->is_startup = TRUE;
+    JS_FreeValue(ctx, *pval);
+    *pval = obj;
+    return 0;
+}
+
 static JSValue JS_ReadFunctionTag(BCReaderState *s)
 {
     JSContext *ctx = s->ctx;
@@ -35506,11 +36081,15 @@ static JSValue JS_ReadFunctionTag(BCReaderState *s)
     int idx, i, local_count;
     int function_size, cpool_offset, byte_code_offset;
     int closure_var_offset, vardefs_offset;
+    uint32_t record_len;
 
     memset(&bc, 0, sizeof(bc));
     bc.header.ref_count = 1;
     //bc.gc_header.mark = 0;
 
+    /* record length: only used to skip lazy functions */
+    if (bc_get_u32(s, &record_len))
+        goto fail;
     if (bc_get_u16(s, &v16))
         goto fail;
     idx = 0;
@@ -35681,7 +36260,20 @@ static JSValue JS_ReadFunctionTag(BCReaderState *s)
         bc_read_trace(s, "cpool {\n");
         for(i = 0; i < b->cpool_count; i++) {
             JSValue val;
-            val = JS_ReadObjectRec(s);
+            if (s->lazy_source && s->ptr < s->buf_end &&
+                *s->ptr == BC_TAG_FUNCTION_BYTECODE) {
+                val = JS_ReadLazyFunctionTag(s);
+            } else if (s->lazy_source && s->ptr < s->buf_end &&
+                       *s->ptr == BC_TAG_FUNCTION_REFERENCE) {
+                const uint8_t *func_ptr;
+                s->ptr++;
+                func_ptr = bc_get_function_reference(s);
+                if (!func_ptr)
+                    goto fail;
+                val = js_new_lazy_function(s, func_ptr);
+            } else {
+                val = JS_ReadObjectRec(s);
+            }
             if (JS_IsException(val))
                 goto fail;
             b->cpool[i] = val;
@@ -36116,6 +36708,20 @@ static JSValue JS_ReadObjectRec(BCReaderState *s)
         obj = JS_ReadBigNum(s, tag);
         break;
 #endif
+    case BC_TAG_FUNCTION_REFERENCE:
+        {
+            const uint8_t *func_ptr, *saved_ptr;
+            if (!s->allow_bytecode)
+                goto invalid_tag;
+            func_ptr = bc_get_function_reference(s);
+            if (!func_ptr)
+                return JS_EXCEPTION;
+            saved_ptr = s->ptr;
+            s->ptr = func_ptr;
+            obj = JS_ReadObjectRec(s);
+            s->ptr = saved_ptr;
+        }
+        break;
     case BC_TAG_OBJECT_REFERENCE:
         {
             uint32_t val;
@@ -36174,13 +36780,33 @@ static int JS_ReadObjectAtoms(BCReaderState *s)
         if (atom == JS_ATOM_NULL)
             return s->error_state = -1;
         s->idx_to_atom[i] = atom;
-        if (s->is_rom_data && (atom != (i + s->first_atom)))
+        if (s->is_rom_data && !s->relocate_in_place &&
+            (atom != (i + s->first_atom)))
             s->is_rom_data = FALSE; /* atoms must be relocated */
     }
     bc_read_trace(s, "}\n");
     return 0;
 }
 
+static int js_lazy_source_new(BCReaderState *s)
+{
+    JSLazySource *ls;
+
+    ls = js_mallocz(s->ctx, sizeof(*ls));
+    if (!ls)
+        return -1;
+    ls->ref_count = 1;
+    ls->buf_start = s->buf_start;
+    ls->buf_end = s->buf_end;
+    ls->first_atom = s->first_atom;
+    ls->idx_to_atom_count = s->idx_to_atom_count;
+    ls->idx_to_atom = s->idx_to_atom;
+    ls->is_rom_data = s->is_rom_data;
+    ls->relocate_in_place = s->relocate_in_place;
+    s->lazy_source = ls;
+    return 0;
+}
+
 static void bc_reader_free(BCReaderState *s)
 {
     int i;
@@ -36209,6 +36835,8 @@ JSValue JS_ReadObject(JSContext *ctx, const uint8_t *buf, size_t buf_len,
     s->ptr = buf;
     s->allow_bytecode = ((flags & JS_READ_OBJ_BYTECODE) != 0);
     s->is_rom_data = ((flags & JS_READ_OBJ_ROM_DATA) != 0);
+    s->relocate_in_place = s->is_rom_data &&
+        ((flags & JS_READ_OBJ_IN_PLACE) != 0);
     s->allow_sab = ((flags & JS_READ_OBJ_SAB) != 0);
     s->allow_reference = ((flags & JS_READ_OBJ_REFERENCE) != 0);
     if (s->allow_bytecode)
@@ -36218,8 +36846,20 @@ JSValue JS_ReadObject(JSContext *ctx, const uint8_t *buf, size_t buf_len,
     if (JS_ReadObjectAtoms(s)) {
         obj = JS_EXCEPTION;
     } else {
+        if ((flags & JS_READ_OBJ_LAZY) && (flags & JS_READ_OBJ_ROM_DATA) &&
+            s->allow_bytecode && !s->allow_reference) {
+            if (js_lazy_source_new(s)) {
+                bc_reader_free(s);
+                return JS_EXCEPTION;
+            }
+        }
         obj = JS_ReadObjectRec(s);
     }
+    if (s->lazy_source) {
+        /* the atom table now belongs to the lazy functions, if any */
+        s->idx_to_atom = NULL;
+        js_lazy_source_free(ctx->rt, s->lazy_source);
+    }
     bc_reader_free(s);
     return obj;
 }
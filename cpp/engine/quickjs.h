@@ -793,6 +793,8 @@ JS_BOOL JS_IsConstructor(JSContext* ctx, JSValueConst val);
 JS_BOOL JS_SetConstructorBit(JSContext *ctx, JSValueConst func_obj, JS_BOOL val);
 
 JSValue JS_NewArray(JSContext *ctx);
+JSValue JS_NewArrayLength(JSContext *ctx, uint32_t len);
+JSValue JS_NewArrayFrom(JSContext *ctx, uint32_t len, JSValue *tab);
 int JS_IsArray(JSContext *ctx, JSValueConst val);
 int JS_IsArrayBuffer(JSContext *ctx, JSValueConst val);
 JSValue JS_GetArrayLength(JSContext *ctx, JSValueConst val);
@@ -843,6 +845,14 @@ int JS_GetOwnPropertyNames(JSContext *ctx, JSPropertyEnum **ptab,
                            uint32_t *plen, JSValueConst obj, int flags);
 int JS_GetOwnProperty(JSContext *ctx, JSPropertyDescriptor *desc,
                       JSValueConst obj, JSAtom prop);
+int JS_GetShapePropertyCount(JSContext *ctx, JSValueConst obj);
+JS_BOOL JS_GetShapeProperty(JSContext *ctx, JSValueConst obj, int idx,
+                            JSAtom *patom, JSValueConst *pvalue);
+/* Return TRUE if 'obj' is a fast array, its elements are then in
+   '*parray'. They are not duplicated and only valid until the array is
+   modified. */
+JS_BOOL JS_GetFastArray(JSContext *ctx, JSValueConst obj,
+                        JSValue **parray, uint32_t *plen);
 
 JSValue JS_Call(JSContext *ctx, JSValueConst func_obj, JSValueConst this_obj,
                 int argc, JSValueConst *argv);
@@ -880,6 +890,19 @@ void *JS_GetOpaque(JSValueConst obj, JSClassID class_id);
 void *JS_GetOpaque2(JSContext *ctx, JSValueConst obj, JSClassID class_id);
 void *JS_GetOpaqueUnsafe(JSValueConst obj);
 
+/* A pointer that can be attached to any object. The runtime's native state
+   finalizer releases it when the object is freed. */
+typedef void JSNativeStateFinalizer(JSRuntime *rt, void *state);
+void JS_SetNativeStateFinalizer(JSRuntime *rt, JSNativeStateFinalizer *finalizer);
+int JS_SetNativeState(JSContext *ctx, JSValueConst obj, void *state);
+void *JS_GetNativeState(JSValueConst obj);
+
+/* Values memoized by the host for an object, see JS_SetMemoizedProperty(). */
+int JS_SetMemoizedProperty(JSContext *ctx, JSValueConst obj, JSAtom prop,
+                           JSValue val);
+void JS_DeleteMemoizedProperty(JSContext *ctx, JSValueConst obj, JSAtom prop);
+void JS_ClearMemoizedProperties(JSContext *ctx, JSValueConst obj);
+
 /* 'buf' must be zero terminated i.e. buf[buf_len] = '\0'. */
 JSValue JS_ParseJSON(JSContext *ctx, const char *buf, size_t buf_len,
                      const char *filename);
@@ -922,6 +945,9 @@ typedef int JSInterruptHandler(JSRuntime *rt, void *opaque);
 void JS_SetInterruptHandler(JSRuntime *rt, JSInterruptHandler *cb, void *opaque);
 /* if can_block is TRUE, Atomics.wait() can be used */
 void JS_SetCanBlock(JSRuntime *rt, JS_BOOL can_block);
+/* while enabled, the bytecode functions which are called are marked for
+   JS_WRITE_OBJ_STARTUP_LAYOUT */
+void JS_SetStartupProfiling(JSRuntime *rt, JS_BOOL enable);
 /* set the [IsHTMLDDA] internal slot */
 void JS_SetIsHTMLDDA(JSContext *ctx, JSValueConst obj);
 
@@ -951,6 +977,8 @@ int JS_EnqueueJob(JSContext *ctx, JSJobFunc *job_func, int argc, JSValueConst *a
 
 JS_BOOL JS_IsJobPending(JSRuntime *rt);
 int JS_ExecutePendingJob(JSRuntime *rt, JSContext **pctx);
+int JS_ExecutePendingJobs(JSRuntime *rt, int max_jobs, int *pcount,
+                          JSContext **pctx);
 
 /* Object Writer/Reader (currently only used to handle precompiled code) */
 #define JS_WRITE_OBJ_BYTECODE  (1 << 0) /* allow function/module */
@@ -959,15 +987,34 @@ int JS_ExecutePendingJob(JSRuntime *rt, JSContext **pctx);
 #define JS_WRITE_OBJ_REFERENCE (1 << 3) /* allow object references to
                                            encode arbitrary object
                                            graph */
+/* with JS_WRITE_OBJ_BYTECODE: the functions executed while
+   JS_SetStartupProfiling() was enabled come first, the other ones are
+   moved at the end of the output */
+#define JS_WRITE_OBJ_STARTUP_LAYOUT (1 << 4)
 uint8_t *JS_WriteObject(JSContext *ctx, size_t *psize, JSValueConst obj,
                         int flags);
 uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
                          int flags, uint8_t ***psab_tab, size_t *psab_tab_len);
+/* 'pstartup_size' is the size of the output prefix holding the startup
+   functions with JS_WRITE_OBJ_STARTUP_LAYOUT, the whole size otherwise */
+uint8_t *JS_WriteObject3(JSContext *ctx, size_t *psize, JSValueConst obj,
+                         int flags, uint8_t ***psab_tab, size_t *psab_tab_len,
+                         size_t *pstartup_size);
+/* identifies the bytecode format: bytecode written by a build returning
+   a different value can't be read */
+uint32_t JS_GetBytecodeVersion(void);
 
 #define JS_READ_OBJ_BYTECODE  (1 << 0) /* allow function/module */
 #define JS_READ_OBJ_ROM_DATA  (1 << 1) /* avoid duplicating 'buf' data */
 #define JS_READ_OBJ_SAB       (1 << 2) /* allow SharedArrayBuffer */
 #define JS_READ_OBJ_REFERENCE (1 << 3) /* allow object references */
+/* with JS_READ_OBJ_ROM_DATA: 'buf' is writable (e.g. a private file
+   mapping), the atoms are relocated in place instead of copying the
+   bytecode. 'buf' must outlive the functions and can only be read once. */
+#define JS_READ_OBJ_IN_PLACE  (1 << 4)
+/* with JS_READ_OBJ_ROM_DATA: the nested functions are only read from
+   'buf' when they are first instantiated */
+#define JS_READ_OBJ_LAZY      (1 << 5)
 JSValue JS_ReadObject(JSContext *ctx, const uint8_t *buf, size_t buf_len,
                       int flags);
 /* instantiate and evaluate a bytecode function. Only used when
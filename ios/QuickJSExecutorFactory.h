@@ -8,6 +8,7 @@
 #ifndef QuickJSExecutorFactory_h
 #define QuickJSExecutorFactory_h
 
+#import <Foundation/Foundation.h>
 #include <jsireact/JSIExecutor.h>
 
 namespace qjs {
@@ -28,4 +29,21 @@ private:
 };
 }
 
+// Code cache settings, shared by all the runtimes of the process.
+@interface QuickJSCodeCache : NSObject
+
+// Hold code cache writes back while |deferred| is YES, e.g. from before the
+// bundle is loaded until the first frame is rendered.
++ (void)setWriteDeferred:(BOOL)deferred;
+
+// Bound the code caches kept on disk to |bytes|, least recently used bundles
+// are evicted first. Defaults to 32MB.
++ (void)setSizeBudget:(NSUInteger)bytes;
+
+// Compress the code caches written from now on. Pays off on slow storage,
+// e.g. on low-end devices. Caches stay readable either way.
++ (void)setCompressed:(BOOL)compressed;
+
+@end
+
 #endif /* QuickJSExecutorFactory_h */
@@ -9,7 +9,9 @@
 
 #import <React/RCTLog.h>
 #import <memory>
+#import <QuickJSExecutor.h>
 #import <QuickJSRuntimeFactory.h>
+#import <cxxreact/MessageQueueThread.h>
 
 #include "jsi/jsi.h"
 
@@ -42,11 +44,36 @@ std::unique_ptr<react::JSExecutor> QuickJSExecutorFactory::createJSExecutor(
       NSLog(@"Create directory error: %@", error);
       codeCacheDir_ = "";
   }
-  return folly::make_unique<react::JSIExecutor>(
-      createQuickJSRuntime(codeCacheDir_),
+  std::weak_ptr<react::MessageQueueThread> weakJSQueue = jsQueue;
+  auto jsThreadScheduler = [weakJSQueue](std::function<void()> &&task) {
+    if (auto queue = weakJSQueue.lock()) {
+      queue->runOnQueue(std::move(task));
+    }
+  };
+  return folly::make_unique<QuickJSExecutor>(
+      createQuickJSRuntime(codeCacheDir_, std::move(jsThreadScheduler)),
       delegate,
       react::JSIExecutor::defaultTimeoutInvoker,
       std::move(installBindings));
 }
 
 } // namespace qjs
+
+@implementation QuickJSCodeCache
+
++ (void)setWriteDeferred:(BOOL)deferred
+{
+  qjs::setCodeCacheWriteDeferred(deferred);
+}
+
++ (void)setSizeBudget:(NSUInteger)bytes
+{
+  qjs::setCodeCacheSizeBudget(bytes);
+}
+
++ (void)setCompressed:(BOOL)compressed
+{
+  qjs::setCodeCacheCompressed(compressed);
+}
+
+@end
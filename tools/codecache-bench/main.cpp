@@ -0,0 +1,211 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "quickjs.h"
+#include "CodeCacheCompression.h"
+
+// Shows when compressing the code cache pays off: loading a compressed
+// cache reads fewer bytes but has to decompress them.
+//
+//   qjs-codecache-bench [-i iterations] [-d dir] input.js
+//
+// Prints the cache sizes, the compression and decompression speeds, then
+// the load time of both variants for typical storage throughputs and the
+// throughput under which compression wins. With -d, both caches are also
+// written to |dir| and read back cold, evicted from the page cache, which
+// measures the actual storage of the device the tool runs on.
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void usage() {
+  fprintf(stderr, "usage: qjs-codecache-bench [-i iterations] [-d dir] input\n");
+}
+
+static bool writeFile(const std::string &path, const std::vector<uint8_t> &data) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size()) &&
+      fsync(fd) == 0;
+  close(fd);
+  return ok;
+}
+
+// Reads |path| after evicting it from the page cache, returns the time in
+// ms or a negative value on failure.
+static double coldReadMs(const std::string &path, size_t size) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+#if defined(__APPLE__)
+  fcntl(fd, F_NOCACHE, 1);
+#else
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+  std::vector<uint8_t> buffer(size);
+  auto start = Clock::now();
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = read(fd, buffer.data() + done, size - done);
+    if (n <= 0) {
+      close(fd);
+      return -1;
+    }
+    done += n;
+  }
+  double ms = elapsedMs(start);
+  close(fd);
+  return ms;
+}
+
+int main(int argc, char **argv) {
+  int iterations = 20;
+  std::string dir;
+  std::string inputPath;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+      dir = argv[++i];
+    } else if (argv[i][0] != '-' && inputPath.empty()) {
+      inputPath = argv[i];
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  if (inputPath.empty() || iterations <= 0) {
+    usage();
+    return 1;
+  }
+
+  std::ifstream input(inputPath, std::ios::binary);
+  if (!input) {
+    fprintf(stderr, "cannot read %s\n", inputPath.c_str());
+    return 1;
+  }
+  std::string source((std::istreambuf_iterator<char>(input)),
+                     std::istreambuf_iterator<char>());
+
+  JSRuntime *runtime = JS_NewRuntime();
+  JSContext *context = JS_NewContext(runtime);
+  JSValue func = JS_Eval(context, source.c_str(), source.size(), inputPath.c_str(),
+                         JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+  if (JS_IsException(func)) {
+    fprintf(stderr, "cannot compile %s\n", inputPath.c_str());
+    return 1;
+  }
+  size_t size;
+  uint8_t *buf = JS_WriteObject(context, &size, func, JS_WRITE_OBJ_BYTECODE);
+  JS_FreeValue(context, func);
+  std::vector<uint8_t> raw(buf, buf + size);
+  js_free(context, buf);
+
+  auto start = Clock::now();
+  std::vector<uint8_t> compressed;
+  for (int i = 0; i < iterations; i++) {
+    compressed.clear();
+    qjs::compressBlocks(raw.data(), raw.size(), compressed);
+  }
+  double compressMs = elapsedMs(start) / iterations;
+
+  std::vector<uint8_t> decompressed(raw.size());
+  start = Clock::now();
+  for (int i = 0; i < iterations; i++) {
+    if (!qjs::decompressBlocks(compressed.data(), compressed.size(),
+                               decompressed.data(), decompressed.size())) {
+      fprintf(stderr, "decompression failed\n");
+      return 1;
+    }
+  }
+  double decompressMs = elapsedMs(start) / iterations;
+  if (decompressed != raw) {
+    fprintf(stderr, "decompression mismatch\n");
+    return 1;
+  }
+
+  // The deserialization cost is the same for both variants.
+  start = Clock::now();
+  for (int i = 0; i < iterations; i++) {
+    JSValue obj = JS_ReadObject(context, raw.data(), raw.size(), JS_READ_OBJ_BYTECODE);
+    JS_FreeValue(context, obj);
+  }
+  double readObjectMs = elapsedMs(start) / iterations;
+
+  double rawMB = raw.size() / 1e6;
+  double compressedMB = compressed.size() / 1e6;
+  printf("cache         %10zu bytes\n", raw.size());
+  printf("compressed    %10zu bytes (%.1f%%)\n", compressed.size(),
+         100.0 * compressed.size() / raw.size());
+  printf("compress      %10.2f ms (%.0f MB/s, on the writer thread)\n", compressMs,
+         rawMB / (compressMs / 1000));
+  printf("decompress    %10.2f ms (%.0f MB/s)\n", decompressMs,
+         rawMB / (decompressMs / 1000));
+  printf("JS_ReadObject %10.2f ms (both variants)\n\n", readObjectMs);
+
+  // Load time = read + decompress. Compression wins when the time saved
+  // reading exceeds the decompression time.
+  struct {
+    const char *name;
+    double mbPerSecond;
+  } storages[] = {
+      {"eMMC 4.5", 80},
+      {"eMMC 5.1", 250},
+      {"UFS 2.1", 700},
+      {"UFS 3.1", 1500},
+  };
+  printf("%-12s %12s %12s\n", "storage", "raw ms", "compressed ms");
+  for (auto &storage : storages) {
+    double rawLoad = rawMB / storage.mbPerSecond * 1000;
+    double compressedLoad = compressedMB / storage.mbPerSecond * 1000 + decompressMs;
+    printf("%-12s %12.2f %12.2f%s\n", storage.name, rawLoad, compressedLoad,
+           compressedLoad < rawLoad ? "  <- compression wins" : "");
+  }
+  if (compressed.size() < raw.size()) {
+    printf("compression wins below %.0f MB/s\n",
+           (rawMB - compressedMB) / (decompressMs / 1000));
+  } else {
+    printf("the cache does not compress\n");
+  }
+
+  if (!dir.empty()) {
+    std::string rawPath = dir + "/bench.raw";
+    std::string compressedPath = dir + "/bench.lz4";
+    if (!writeFile(rawPath, raw) || !writeFile(compressedPath, compressed)) {
+      fprintf(stderr, "cannot write to %s\n", dir.c_str());
+      return 1;
+    }
+    double rawRead = coldReadMs(rawPath, raw.size());
+    double compressedRead = coldReadMs(compressedPath, compressed.size());
+    unlink(rawPath.c_str());
+    unlink(compressedPath.c_str());
+    if (rawRead < 0 || compressedRead < 0) {
+      fprintf(stderr, "cannot read back from %s\n", dir.c_str());
+      return 1;
+    }
+    printf("\nmeasured cold load in %s\n", dir.c_str());
+    printf("raw           %10.2f ms\n", rawRead);
+    printf("compressed    %10.2f ms (%.2f read + %.2f decompress)\n",
+           compressedRead + decompressMs, compressedRead, decompressMs);
+  }
+
+  JS_FreeContext(context);
+  JS_FreeRuntime(runtime);
+  return 0;
+}
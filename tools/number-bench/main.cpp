@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <initializer_list>
+
+#include "quickjs.h"
+
+// Shows what JS_TAG_INT buys over float64 for numbers coming from native,
+// which is why JSIValueConverter::ToJSNumber tags integral doubles as ints.
+//
+//   qjs-number-bench [-i iterations]
+//
+// Each case calls into JS with the same integral numbers, once tagged as
+// ints and once as float64 values, like a list renderer passing row indices
+// and view ids.
+
+using Clock = std::chrono::steady_clock;
+
+static const char *kScript = R"(
+var rows = [];
+for (var i = 0; i < 10000; i++) {
+  rows.push({ id: i, height: 40 + (i & 7) });
+}
+// Per row callback, the index comes from native.
+function getRow(index) {
+  return rows[index].id;
+}
+// Index-heavy loop, its bounds come from native.
+function layout(start, end) {
+  var offset = 0;
+  for (var i = start; i < end; i++) {
+    offset += rows[i].height;
+  }
+  return offset;
+}
+// Arithmetic and comparisons on a native tag.
+function matchTag(tag) {
+  var count = 0;
+  for (var i = 0; i < 100; i++) {
+    if ((tag + i) % 3 === 0) {
+      count++;
+    }
+  }
+  return count;
+}
+)";
+
+static JSValue newNumber(JSContext *context, int32_t value, bool tagInt) {
+  return tagInt ? JS_NewInt32(context, value) : __JS_NewFloat64(context, value);
+}
+
+static double run(JSContext *context, const char *name, int iterations, bool tagInt) {
+  JSValue global = JS_GetGlobalObject(context);
+  JSValue func = JS_GetPropertyStr(context, global, name);
+  auto start = Clock::now();
+  for (int i = 0; i < iterations; i++) {
+    JSValue argv[2];
+    int argc;
+    if (!strcmp(name, "getRow")) {
+      argv[0] = newNumber(context, i % 10000, tagInt);
+      argc = 1;
+    } else if (!strcmp(name, "layout")) {
+      argv[0] = newNumber(context, 0, tagInt);
+      argv[1] = newNumber(context, 200, tagInt);
+      argc = 2;
+    } else {
+      argv[0] = newNumber(context, i, tagInt);
+      argc = 1;
+    }
+    JSValue result = JS_Call(context, func, global, argc, argv);
+    if (JS_IsException(result)) {
+      fprintf(stderr, "%s failed\n", name);
+      exit(1);
+    }
+    JS_FreeValue(context, result);
+  }
+  double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  JS_FreeValue(context, func);
+  JS_FreeValue(context, global);
+  return ms;
+}
+
+int main(int argc, char **argv) {
+  int iterations = 20000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: qjs-number-bench [-i iterations]\n");
+      return 1;
+    }
+  }
+
+  JSRuntime *runtime = JS_NewRuntime();
+  JSContext *context = JS_NewContext(runtime);
+  JSValue ret = JS_Eval(context, kScript, strlen(kScript), "bench.js", JS_EVAL_TYPE_GLOBAL);
+  if (JS_IsException(ret)) {
+    fprintf(stderr, "cannot evaluate the benchmark\n");
+    return 1;
+  }
+  JS_FreeValue(context, ret);
+
+  printf("%-10s %12s %12s %8s\n", "case", "int ms", "float64 ms", "speedup");
+  for (const char *name : {"getRow", "layout", "matchTag"}) {
+    // Warm up both variants first.
+    run(context, name, iterations / 10, true);
+    run(context, name, iterations / 10, false);
+    double intMs = run(context, name, iterations, true);
+    double floatMs = run(context, name, iterations, false);
+    printf("%-10s %12.2f %12.2f %7.2fx\n", name, intMs, floatMs, floatMs / intMs);
+  }
+
+  JS_FreeContext(context);
+  JS_FreeRuntime(runtime);
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "quickjs.h"
+#include "BytecodeBundle.h"
+
+// Compiles a JS bundle to a bytecode bundle that evaluateJavaScript loads
+// with JS_ReadObject, skipping the compile at first launch.
+//
+//   qjs-precompiler [-s] [-n sourceURL] -o output.hbc input.js
+//
+// -s strips the debug info (line numbers, source), -n sets the file name
+// reported in stack traces.
+
+static void usage() {
+  fprintf(stderr,
+          "usage: qjs-precompiler [-s] [-n sourceURL] -o output input\n");
+}
+
+static void dumpException(JSContext *context) {
+  JSValue exception = JS_GetException(context);
+  const char *str = JS_ToCString(context, exception);
+  fprintf(stderr, "%s\n", str ? str : "compile error");
+  JS_FreeCString(context, str);
+  if (JS_IsError(context, exception)) {
+    JSValue stack = JS_GetPropertyStr(context, exception, "stack");
+    if (!JS_IsUndefined(stack)) {
+      str = JS_ToCString(context, stack);
+      fprintf(stderr, "%s\n", str ? str : "");
+      JS_FreeCString(context, str);
+    }
+    JS_FreeValue(context, stack);
+  }
+  JS_FreeValue(context, exception);
+}
+
+int main(int argc, char **argv) {
+  bool strip = false;
+  std::string sourceURL;
+  std::string outputPath;
+  std::string inputPath;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-s")) {
+      strip = true;
+    } else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+      sourceURL = argv[++i];
+    } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+      outputPath = argv[++i];
+    } else if (argv[i][0] != '-' && inputPath.empty()) {
+      inputPath = argv[i];
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  if (inputPath.empty() || outputPath.empty()) {
+    usage();
+    return 1;
+  }
+  if (sourceURL.empty()) {
+    sourceURL = inputPath;
+  }
+
+  std::ifstream input(inputPath, std::ios::binary);
+  if (!input) {
+    fprintf(stderr, "cannot read %s\n", inputPath.c_str());
+    return 1;
+  }
+  // JS_Eval needs a null terminated buffer.
+  std::string source((std::istreambuf_iterator<char>(input)),
+                     std::istreambuf_iterator<char>());
+
+  JSRuntime *runtime = JS_NewRuntime();
+  JSContext *context = JS_NewContext(runtime);
+  int flags = JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY;
+  if (strip) {
+    flags |= JS_EVAL_FLAG_STRIP;
+  }
+
+  int ret = 1;
+  JSValue func = JS_Eval(
+      context, source.c_str(), source.size(), sourceURL.c_str(), flags);
+  if (JS_IsException(func)) {
+    dumpException(context);
+  } else {
+    size_t size;
+    uint8_t *buf = JS_WriteObject(context, &size, func, JS_WRITE_OBJ_BYTECODE);
+    if (buf) {
+      std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+      output.write(reinterpret_cast<const char *>(qjs::kBytecodeBundleMagic),
+                   qjs::kBytecodeBundleHeaderSize);
+      output.write(reinterpret_cast<const char *>(buf), size);
+      output.close();
+      if (output) {
+        ret = 0;
+      } else {
+        fprintf(stderr, "cannot write %s\n", outputPath.c_str());
+      }
+      js_free(context, buf);
+    } else {
+      dumpException(context);
+    }
+    JS_FreeValue(context, func);
+  }
+
+  JS_FreeContext(context);
+  JS_FreeRuntime(runtime);
+  return ret;
+}